@@ -5,7 +5,9 @@
 
 #include <complex>
 
+#include <cstdint>
 #include <type_traits>
+#include <utility>
  
 #include "ArrayType.hpp"
 #include "TypedArray.hpp"
@@ -108,6 +110,101 @@ namespace matlab {
 
             } /* switch */
         } /* apply_visitor */
+
+        namespace detail {
+            /**
+             * Result of a numeric visitor: the common type of what it returns for each element type, so a
+             * kernel returning T for const T* data still yields one type for the whole dispatch.
+             */
+            template<typename V>
+            struct numeric_visit_result {
+                template<typename T>
+                struct of {
+                    typedef decltype(std::declval<V&>()(static_cast<const T*>(nullptr), size_t(0))) type;
+                };
+                typedef typename std::common_type<
+                    typename of<bool>::type, typename of<double>::type, typename of<float>::type,
+                    typename of<int8_t>::type, typename of<uint8_t>::type,
+                    typename of<int16_t>::type, typename of<uint16_t>::type,
+                    typename of<int32_t>::type, typename of<uint32_t>::type,
+                    typename of<int64_t>::type, typename of<uint64_t>::type>::type type;
+            };
+
+            template<ArrayType Type, typename V>
+            typename numeric_visit_result<V>::type visit_numeric_kernel(const Array& a, V& visitor)
+            {
+                typedef typename GetElementType<Type>::type T;
+                typedef typename numeric_visit_result<V>::type R;
+                const TypedArray<T> typed{Array(a)};
+                const size_t numElements = typed.getNumberOfElements();
+                // An empty array has no element to point at, so its kernel gets a null pointer
+                const T* data = nullptr;
+                if (numElements != 0) {
+                    data = typed.cbegin().operator->();
+                }
+                return(static_cast<R>(visitor(data, numElements)));
+            }
+
+            template<typename V>
+            typename numeric_visit_result<V>::type dispatch_numeric(const Array& a, V& visitor)
+            {
+                switch (a.getType()) {
+                  case ArrayType::LOGICAL: return(visit_numeric_kernel<ArrayType::LOGICAL>(a, visitor));
+                  case ArrayType::DOUBLE: return(visit_numeric_kernel<ArrayType::DOUBLE>(a, visitor));
+                  case ArrayType::SINGLE: return(visit_numeric_kernel<ArrayType::SINGLE>(a, visitor));
+                  case ArrayType::INT8:   return(visit_numeric_kernel<ArrayType::INT8>(a, visitor));
+                  case ArrayType::UINT8:  return(visit_numeric_kernel<ArrayType::UINT8>(a, visitor));
+                  case ArrayType::INT16:  return(visit_numeric_kernel<ArrayType::INT16>(a, visitor));
+                  case ArrayType::UINT16: return(visit_numeric_kernel<ArrayType::UINT16>(a, visitor));
+                  case ArrayType::INT32:  return(visit_numeric_kernel<ArrayType::INT32>(a, visitor));
+                  case ArrayType::UINT32: return(visit_numeric_kernel<ArrayType::UINT32>(a, visitor));
+                  case ArrayType::INT64:  return(visit_numeric_kernel<ArrayType::INT64>(a, visitor));
+                  case ArrayType::UINT64: return(visit_numeric_kernel<ArrayType::UINT64>(a, visitor));
+
+                  default:
+                    throw InvalidArrayTypeException("Array is not a real numeric or logical type");
+                    break;
+
+                } /* switch */
+            } /* dispatch_numeric */
+        }
+
+        /**
+         * Dispatch once on the type of a real numeric or logical Array and invoke the visitor on the
+         * contiguous element data. The visitor must provide a templated
+         * operator()(const T* data, size_t numElements), so one kernel is instantiated per element type
+         * and the inner loop runs over a raw pointer instead of a TypedIterator. data is null for an empty
+         * Array. The result is the common type of the visitor's results for all element types.
+         *
+         * @param a - Array to visit
+         * @param visitor - kernel to invoke on the element data
+         * @return the result of the visitor
+         * @throw InvalidArrayTypeException if the Array is not a real numeric or logical type
+         */
+        template<typename V>
+        typename detail::numeric_visit_result<V>::type visit_numeric(const Array& a, V visitor)
+        {
+            return(detail::dispatch_numeric(a, visitor));
+        } /* visit_numeric */
+
+        /**
+         * Invoke visit_numeric on each element of a cell array, dispatching once per cell. The same
+         * visitor instance is used for every cell so it can accumulate a reduction.
+         *
+         * @param cell - cell array whose elements are all real numeric or logical arrays
+         * @param visitor - kernel to invoke on the element data of each cell
+         * @return the visitor after it has seen every cell
+         * @throw InvalidArrayTypeException if a cell is not a real numeric or logical type
+         */
+        template<typename V>
+        V for_each_numeric(const CellArray& cell, V visitor)
+        {
+            for (auto it = cell.begin(); it != cell.end(); ++it) {
+                Array elem = *it;
+                detail::dispatch_numeric(elem, visitor);
+            }
+            return visitor;
+        } /* for_each_numeric */
     }
 }
 
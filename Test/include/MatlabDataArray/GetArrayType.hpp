@@ -66,6 +66,23 @@ namespace matlab {
         template<> struct GetSparseArrayType<double> { static const ArrayType type = ArrayType::SPARSE_DOUBLE; };
         template<> struct GetSparseArrayType<std::complex<double>> { static const ArrayType type = ArrayType::SPARSE_COMPLEX_DOUBLE; };
 
+        /**
+         * Compile-time inverse of GetArrayType for the real numeric and logical types. Used by
+         * visit_numeric to instantiate one kernel per element type.
+         */
+        template<ArrayType Type> struct GetElementType;
+        template<> struct GetElementType<ArrayType::LOGICAL> { typedef bool type; };
+        template<> struct GetElementType<ArrayType::DOUBLE> { typedef double type; };
+        template<> struct GetElementType<ArrayType::SINGLE> { typedef float type; };
+        template<> struct GetElementType<ArrayType::INT8> { typedef int8_t type; };
+        template<> struct GetElementType<ArrayType::UINT8> { typedef uint8_t type; };
+        template<> struct GetElementType<ArrayType::INT16> { typedef int16_t type; };
+        template<> struct GetElementType<ArrayType::UINT16> { typedef uint16_t type; };
+        template<> struct GetElementType<ArrayType::INT32> { typedef int32_t type; };
+        template<> struct GetElementType<ArrayType::UINT32> { typedef uint32_t type; };
+        template<> struct GetElementType<ArrayType::INT64> { typedef int64_t type; };
+        template<> struct GetElementType<ArrayType::UINT64> { typedef uint64_t type; };
+
 
     }
 }
@@ -10,15 +10,23 @@
 #include <MatlabEngine/engine_util.hpp>
 #include <MatlabEngine/engine_exception.hpp>
 #include <MatlabEngine/value_future.hpp>
+#include <MatlabEngine/future_continuation.hpp>
 #include <MatlabEngine/matlab_engine.hpp>
 #include <MatlabEngine/engine_future.hpp>
 #include <MatlabEngine/engine_factory.hpp>
+#include <MatlabEngine/feval_batcher.hpp>
+#include <MatlabEngine/engine_pool.hpp>
+#include <MatlabEngine/mock_matlab_engine.hpp>
 #include <MatlabEngine/detail/task_reference_impl.hpp>
 #include <MatlabEngine/detail/engine_util_impl.hpp>
 #include <MatlabEngine/detail/engine_exception_impl.hpp>
 #include <MatlabEngine/detail/value_future_impl.hpp>
+#include <MatlabEngine/detail/future_continuation_impl.hpp>
 #include <MatlabEngine/detail/matlab_engine_impl.hpp>
 #include <MatlabEngine/detail/engine_future_impl.hpp>
 #include <MatlabEngine/detail/engine_factory_impl.hpp>
+#include <MatlabEngine/detail/feval_batcher_impl.hpp>
+#include <MatlabEngine/detail/engine_pool_impl.hpp>
+#include <MatlabEngine/detail/mock_matlab_engine_impl.hpp>
 
 #endif  //MATLABENGINE_HPP
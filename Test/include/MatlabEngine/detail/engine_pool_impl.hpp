@@ -0,0 +1,431 @@
+// engine_pool_impl.hpp : EnginePool implementation
+
+#ifndef ENGINE_POOL_IMPL_HPP
+#define ENGINE_POOL_IMPL_HPP
+
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include "../engine_pool.hpp"
+#include "../value_future.hpp"
+#include "../future_continuation.hpp"
+#include "../matlab_engine.hpp"
+#include "../engine_factory.hpp"
+#include "../engine_exception.hpp"
+
+namespace matlab {
+    namespace engine {
+
+        namespace detail {
+            template<class EngineT>
+            inline std::function<std::unique_ptr<EngineT>()> defaultEngineFactory(const std::vector<String>&) {
+                return []() { return std::unique_ptr<EngineT>(new EngineT()); };
+            }
+
+            template<>
+            inline std::function<std::unique_ptr<MATLABEngine>()> defaultEngineFactory<MATLABEngine>(const std::vector<String>& startupOptions) {
+                return [startupOptions]() { return startMATLAB(startupOptions); };
+            }
+        }
+
+        template <class EngineT>
+        struct BasicEngineLease<EngineT>::PooledEngine {
+            std::unique_ptr<EngineT> engine;
+            size_t calls;
+            std::chrono::steady_clock::time_point lastChecked;
+
+            /** Set while a health check is in flight; the session is not destroyed until it clears */
+            bool checking;
+
+            /** Set when a health check failed; the session is recycled instead of being leased again */
+            bool unhealthy;
+        };
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT>::BasicEngineLease() : pool(nullptr), engine(), calls(0), failed(false) {}
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT>::BasicEngineLease(BasicEnginePool<EngineT>* a_pool, std::unique_ptr<PooledEngine>&& a_engine) :
+            pool(a_pool), engine(std::move(a_engine)), calls(1), failed(false) {}
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT>::BasicEngineLease(BasicEngineLease&& rhs) : pool(rhs.pool), engine(std::move(rhs.engine)), calls(rhs.calls), failed(rhs.failed) {
+            rhs.pool = nullptr;
+        }
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT>& BasicEngineLease<EngineT>::operator=(BasicEngineLease&& rhs) {
+            if (this != &rhs) {
+                release();
+                pool = rhs.pool;
+                engine = std::move(rhs.engine);
+                calls = rhs.calls;
+                failed = rhs.failed;
+                rhs.pool = nullptr;
+            }
+            return *this;
+        }
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT>::~BasicEngineLease() {
+            release();
+        }
+
+        template <class EngineT>
+        inline bool BasicEngineLease<EngineT>::valid() const {
+            return engine != nullptr;
+        }
+
+        template <class EngineT>
+        inline EngineT& BasicEngineLease<EngineT>::operator*() const {
+            return *engine->engine;
+        }
+
+        template <class EngineT>
+        inline EngineT* BasicEngineLease<EngineT>::operator->() const {
+            return engine->engine.get();
+        }
+
+        template <class EngineT>
+        inline EngineT* BasicEngineLease<EngineT>::get() const {
+            return engine ? engine->engine.get() : nullptr;
+        }
+
+        template <class EngineT>
+        inline void BasicEngineLease<EngineT>::recordCalls(size_t count) {
+            calls += count;
+        }
+
+        template <class EngineT>
+        inline void BasicEngineLease<EngineT>::reportError() {
+            failed = true;
+        }
+
+        template <class EngineT>
+        inline void BasicEngineLease<EngineT>::release() {
+            if (pool != nullptr && engine) {
+                pool->giveBack(std::move(engine), calls, failed);
+            }
+            pool = nullptr;
+            engine.reset();
+        }
+
+        template <class EngineT>
+        inline BasicEnginePool<EngineT>::BasicEnginePool(const options_type& a_options) :
+            options(a_options), counters(), retryAfter(), stopping(false) {
+            if (options.size == 0) {
+                throw EngineException("The engine pool size must be greater than zero.");
+            }
+            if (!options.factory) {
+                options.factory = detail::defaultEngineFactory<EngineT>(options.startupOptions);
+            }
+            maintainer = std::thread(&BasicEnginePool::maintainLoop, this);
+        }
+
+        template <class EngineT>
+        inline BasicEnginePool<EngineT>::~BasicEnginePool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            engineAvailable.notify_all();
+            maintenanceNeeded.notify_all();
+            maintainer.join();
+
+            // Only the maintainer adds to starts and checks, so they can be walked without the lock now
+            for (auto& check : checks) {
+                check.cancel();
+            }
+            for (auto& check : checks) {
+                check.wait();
+            }
+            for (auto& start : starts) {
+                start.wait();
+            }
+
+            std::vector<std::unique_ptr<PooledEngine>> toDestroy;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                toDestroy.swap(idle);
+                for (auto& engine : retired) {
+                    toDestroy.push_back(std::move(engine));
+                }
+                retired.clear();
+            }
+        }
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT> BasicEnginePool<EngineT>::lease() {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mutex);
+            engineAvailable.wait(lock, [this]() { return !idle.empty() || stopping; });
+            return take(start);
+        }
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT> BasicEnginePool<EngineT>::tryLease(std::chrono::milliseconds timeout) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!engineAvailable.wait_for(lock, timeout, [this]() { return !idle.empty() || stopping; })) {
+                return lease_type();
+            }
+            return take(start);
+        }
+
+        template <class EngineT>
+        inline BasicEngineLease<EngineT> BasicEnginePool<EngineT>::take(std::chrono::steady_clock::time_point start) {
+            if (stopping) {
+                throw EngineException("The engine pool is shutting down.");
+            }
+            std::unique_ptr<PooledEngine> engine = std::move(idle.back());
+            idle.pop_back();
+            ++counters.leased;
+            ++counters.leasesGranted;
+            counters.totalLeaseWait += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            return lease_type(this, std::move(engine));
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::giveBack(std::unique_ptr<PooledEngine>&& engine, size_t calls, bool failed) {
+            bool recycle;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                engine->calls += calls;
+                recycle = failed || engine->unhealthy || (options.maxCallsPerSession != 0 && engine->calls >= options.maxCallsPerSession);
+                --counters.leased;
+                if (recycle) {
+                    retired.push_back(std::move(engine));
+                    ++counters.sessionsRecycled;
+                }
+                else {
+                    idle.push_back(std::move(engine));
+                }
+            }
+            if (recycle) {
+                maintenanceNeeded.notify_one();
+            }
+            else {
+                engineAvailable.notify_one();
+            }
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::waitUntilReady() {
+            std::unique_lock<std::mutex> lock(mutex);
+            engineAvailable.wait(lock, [this]() { return idle.size() + counters.leased >= options.size || stopping; });
+        }
+
+        template <class EngineT>
+        inline EnginePoolMetrics BasicEnginePool<EngineT>::metrics() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            EnginePoolMetrics snapshot = counters;
+            snapshot.idle = idle.size();
+            return snapshot;
+        }
+
+        template <class EngineT>
+        inline std::unique_ptr<typename BasicEnginePool<EngineT>::PooledEngine> BasicEnginePool<EngineT>::startSession() {
+            std::unique_ptr<PooledEngine> pooled(new PooledEngine);
+            pooled->engine = options.factory();
+            if (!pooled->engine) {
+                throw EngineException("The engine pool factory did not create a session.");
+            }
+            if (!options.prewarmScript.empty()) {
+                pooled->engine->eval(options.prewarmScript);
+            }
+            pooled->calls = 0;
+            pooled->lastChecked = std::chrono::steady_clock::now();
+            pooled->checking = false;
+            pooled->unhealthy = false;
+            return pooled;
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::startTask() {
+            std::unique_ptr<PooledEngine> engine;
+            try {
+                engine = startSession();
+            }
+            catch (...) {
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --counters.starting;
+                if (engine) {
+                    ++counters.sessionsStarted;
+                    if (stopping) {
+                        retired.push_back(std::move(engine));
+                    }
+                    else {
+                        idle.push_back(std::move(engine));
+                        engineAvailable.notify_all();
+                        return;
+                    }
+                }
+                else {
+                    ++counters.startFailures;
+                    retryAfter = std::chrono::steady_clock::now() + options.startRetryDelay;
+                }
+            }
+            // Let the maintainer schedule the retry
+            maintenanceNeeded.notify_one();
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::checkDone(PooledEngine* engine, bool healthy) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                engine->checking = false;
+                --counters.checking;
+                if (healthy) {
+                    engine->lastChecked = std::chrono::steady_clock::now();
+                }
+                else {
+                    ++counters.healthCheckFailures;
+                    engine->unhealthy = true;
+                    // A leased session is recycled by giveBack; an idle one now
+                    for (size_t i = 0; i < idle.size(); i++) {
+                        if (idle[i].get() == engine) {
+                            retired.push_back(std::move(idle[i]));
+                            idle.erase(idle.begin() + i);
+                            ++counters.sessionsRecycled;
+                            break;
+                        }
+                    }
+                }
+            }
+            // The session may have been retired while it was checked; it can be destroyed now
+            maintenanceNeeded.notify_one();
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::startMissing() {
+            size_t live = idle.size() + counters.leased + counters.starting;
+            if (live >= options.size || std::chrono::steady_clock::now() < retryAfter) return;
+
+            size_t missing = options.size - live;
+            starts.reserve(starts.size() + missing);
+            for (; missing != 0; missing--) {
+                // Counted first: the task decrements it once it gets the lock
+                ++counters.starting;
+                try {
+                    starts.push_back(std::async(std::launch::async, &BasicEnginePool::startTask, this));
+                }
+                catch (...) {
+                    --counters.starting;
+                    ++counters.startFailures;
+                    retryAfter = std::chrono::steady_clock::now() + options.startRetryDelay;
+                    return;
+                }
+            }
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::checkIdle() {
+            if (options.healthCheck.empty()) return;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            for (auto& idleEngine : idle) {
+                PooledEngine* engine = idleEngine.get();
+                if (engine->checking || now - engine->lastChecked < options.healthCheckInterval) continue;
+
+                // The session stays in idle, so it can still be leased while the check is in flight
+                engine->checking = true;
+                ++counters.checking;
+                try {
+                    checks.push_back(engine->engine->evalAsync(options.healthCheck).then([this, engine](FutureResult<void> result) {
+                        bool healthy = true;
+                        try {
+                            result.get();
+                        }
+                        catch (...) {
+                            healthy = false;
+                        }
+                        checkDone(engine, healthy);
+                    }));
+                }
+                catch (...) {
+                    engine->checking = false;
+                    --counters.checking;
+                    engine->unhealthy = true;
+                    ++counters.healthCheckFailures;
+                }
+            }
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::reapTasks() {
+            auto ready = [](const FutureResult<void>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+            checks.erase(std::remove_if(checks.begin(), checks.end(), ready), checks.end());
+            auto started = [](const std::future<void>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+            starts.erase(std::remove_if(starts.begin(), starts.end(), started), starts.end());
+        }
+
+        template <class EngineT>
+        inline void BasicEnginePool<EngineT>::maintainLoop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                reapTasks();
+                checkIdle();
+
+                // Sessions whose check could not even be sent are recycled here
+                for (size_t i = 0; i < idle.size();) {
+                    if (idle[i]->unhealthy && !idle[i]->checking) {
+                        retired.push_back(std::move(idle[i]));
+                        idle.erase(idle.begin() + i);
+                        ++counters.sessionsRecycled;
+                    }
+                    else {
+                        ++i;
+                    }
+                }
+
+                // A session is not destroyed while its health check is in flight
+                std::vector<std::unique_ptr<PooledEngine>> toDestroy;
+                for (size_t i = 0; i < retired.size();) {
+                    if (!retired[i]->checking) {
+                        toDestroy.push_back(std::move(retired[i]));
+                        retired.erase(retired.begin() + i);
+                    }
+                    else {
+                        ++i;
+                    }
+                }
+                if (!toDestroy.empty()) {
+                    lock.unlock();
+                    toDestroy.clear();
+                    lock.lock();
+                    continue;
+                }
+
+                startMissing();
+
+                auto needed = [this]() {
+                    if (stopping) return true;
+                    for (auto& engine : retired) {
+                        if (!engine->checking) return true;
+                    }
+                    return idle.size() + counters.leased + counters.starting < options.size &&
+                        std::chrono::steady_clock::now() >= retryAfter;
+                };
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                std::chrono::steady_clock::time_point wakeUp = now + options.healthCheckInterval;
+                if (retryAfter > now && retryAfter < wakeUp) {
+                    wakeUp = retryAfter;
+                }
+                if (!needed()) {
+                    maintenanceNeeded.wait_until(lock, wakeUp);
+                }
+            }
+        }
+    }
+}
+
+#endif /* ENGINE_POOL_IMPL_HPP */
@@ -0,0 +1,276 @@
+// feval_batcher_impl.hpp : FevalBatcher implementation
+
+#ifndef FEVAL_BATCHER_IMPL_HPP
+#define FEVAL_BATCHER_IMPL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <MatlabDataArray/ArrayFactory.hpp>
+#include "../feval_batcher.hpp"
+#include "../future_continuation.hpp"
+#include "../matlab_engine.hpp"
+#include "../value_future.hpp"
+#include "../task_reference.hpp"
+#include "../engine_exception.hpp"
+#include "matlab_engine_impl.hpp"
+
+namespace matlab {
+    namespace engine {
+
+        template <class EngineT>
+        struct BasicFevalBatcher<EngineT>::Call {
+            enum State {
+                PENDING = 0,
+                SUBMITTED = 1,
+                CANCELLED = 2
+            };
+
+            Call(const std::vector<matlab::data::Array> &a_args) : args(a_args), state(PENDING), key(nullptr) {}
+
+            bool markSubmitted() {
+                int expected = PENDING;
+                return state.compare_exchange_strong(expected, SUBMITTED);
+            }
+
+            bool cancel() {
+                int expected = PENDING;
+                if (!state.compare_exchange_strong(expected, CANCELLED)) {
+                    return false;
+                }
+                promise.set_exception(std::make_exception_ptr(CancelledException("The call was cancelled before its batch was submitted.")));
+                FutureExecutor::notifyCompletion(key);
+                return true;
+            }
+
+            std::vector<matlab::data::Array> args;
+            std::chrono::steady_clock::time_point enqueued;
+            std::promise<matlab::data::Array> promise;
+            std::atomic<int> state;
+            const void* key;
+        };
+
+        template <class EngineT>
+        struct BasicFevalBatcher<EngineT>::Batch {
+            std::vector<std::shared_ptr<Call>> calls;
+            FutureResult<matlab::data::Array> result;
+        };
+
+        template <class EngineT>
+        inline BasicFevalBatcher<EngineT>::BasicFevalBatcher(EngineT& a_engine,
+                                                             const String &a_batchFunction,
+                                                             size_t a_nrhs,
+                                                             size_t a_maxBatchSize,
+                                                             std::chrono::milliseconds a_maxDelay) :
+            engine(a_engine), batchFunction(a_batchFunction), nrhs(a_nrhs), maxBatchSize(a_maxBatchSize), maxDelay(a_maxDelay),
+            flushRequested(false), stopping(false), drained(false) {
+            if (nrhs == 0 || maxBatchSize == 0) {
+                throw EngineException("The number of arguments and the batch size must be greater than zero.");
+            }
+            submitter = std::thread(&BasicFevalBatcher::submitLoop, this);
+            try {
+                collector = std::thread(&BasicFevalBatcher::collectLoop, this);
+            }
+            catch (...) {
+                // The destructor does not run for a partly constructed batcher, so join the submitter here
+                stopSubmitter();
+                throw;
+            }
+        }
+
+        template <class EngineT>
+        inline BasicFevalBatcher<EngineT>::~BasicFevalBatcher() {
+            stopSubmitter();
+            collector.join();
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::stopSubmitter() {
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                stopping = true;
+            }
+            pendingReady.notify_all();
+            submitter.join();
+        }
+
+        template <class EngineT>
+        inline FutureResult<matlab::data::Array> BasicFevalBatcher<EngineT>::fevalAsync(const std::vector<matlab::data::Array> &args) {
+            if (args.size() != nrhs) {
+                throw EngineException("The number of arguments does not match the batched function.");
+            }
+            std::shared_ptr<Call> call = std::make_shared<Call>(args);
+            std::future<matlab::data::Array> stdF = call->promise.get_future();
+            std::weak_ptr<Call> weakCall = call;
+            std::shared_ptr<TaskReference> taskReference = std::make_shared<TaskReference>([weakCall](uintptr_t, bool) {
+                std::shared_ptr<Call> c = weakCall.lock();
+                return c && c->cancel();
+            });
+            taskReference->setCompletionKey(taskReference.get());
+            call->key = taskReference.get();
+
+            bool wake = false;
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                // Stamped under the lock so that pending stays ordered by enqueue time
+                call->enqueued = std::chrono::steady_clock::now();
+                pending.push_back(std::move(call));
+                // The first call starts the submitter's maxDelay timer; a full batch ends it early
+                wake = pending.size() == 1 || pending.size() >= maxBatchSize;
+            }
+            if (wake) {
+                pendingReady.notify_one();
+            }
+            return FutureResult<matlab::data::Array>(std::move(stdF), taskReference);
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::flush() {
+            {
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                flushRequested = true;
+            }
+            pendingReady.notify_one();
+        }
+
+        template <class EngineT>
+        inline size_t BasicFevalBatcher<EngineT>::pendingCount() const {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            return pending.size();
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::submitLoop() {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            for (;;) {
+                if (pending.empty()) {
+                    flushRequested = false;
+                    if (stopping) break;
+                    pendingReady.wait(lock);
+                    continue;
+                }
+
+                // pending is in enqueue order, so its front is the call that has waited longest
+                std::chrono::steady_clock::time_point deadline = pending.front()->enqueued + maxDelay;
+                if (!stopping && !flushRequested && pending.size() < maxBatchSize && std::chrono::steady_clock::now() < deadline) {
+                    pendingReady.wait_until(lock, deadline);
+                    continue;
+                }
+
+                std::vector<std::shared_ptr<Call>> calls;
+                if (pending.size() > maxBatchSize) {
+                    calls.assign(pending.begin(), pending.begin() + maxBatchSize);
+                    pending.erase(pending.begin(), pending.begin() + maxBatchSize);
+                }
+                else {
+                    calls.swap(pending);
+                }
+
+                lock.unlock();
+                submit(calls);
+                lock.lock();
+            }
+            lock.unlock();
+
+            {
+                std::lock_guard<std::mutex> inFlightLock(inFlightMutex);
+                drained = true;
+            }
+            inFlightReady.notify_one();
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::submit(std::vector<std::shared_ptr<Call>>& calls) {
+            std::unique_ptr<Batch> batch(new Batch);
+            for (auto& call : calls) {
+                if (call->markSubmitted()) {
+                    batch->calls.push_back(call);
+                }
+            }
+            if (batch->calls.empty()) return;
+
+            const size_t batchSize = batch->calls.size();
+            try {
+                matlab::data::ArrayFactory factory;
+                std::vector<matlab::data::Array> batchArgs;
+                batchArgs.reserve(nrhs);
+                for (size_t i = 0; i < nrhs; i++) {
+                    matlab::data::CellArray cell = factory.createCellArray({ 1, batchSize });
+                    for (size_t k = 0; k < batchSize; k++) {
+                        assignArray(cell[k], batch->calls[k]->args[i]);
+                    }
+                    batchArgs.push_back(std::move(cell));
+                }
+                for (auto& call : batch->calls) {
+                    call->args.clear();
+                }
+                batch->result = engine.fevalAsync(batchFunction, batchArgs);
+            }
+            catch (...) {
+                std::exception_ptr e = std::current_exception();
+                for (auto& call : batch->calls) {
+                    call->promise.set_exception(e);
+                    FutureExecutor::notifyCompletion(call->key);
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(inFlightMutex);
+                inFlight.push_back(std::move(batch));
+            }
+            inFlightReady.notify_one();
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::collectLoop() {
+            for (;;) {
+                std::unique_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(inFlightMutex);
+                    inFlightReady.wait(lock, [this]() { return !inFlight.empty() || drained; });
+                    if (inFlight.empty()) break;
+                    batch = std::move(inFlight.front());
+                    inFlight.pop_front();
+                }
+                scatter(*batch);
+            }
+        }
+
+        template <class EngineT>
+        inline void BasicFevalBatcher<EngineT>::scatter(Batch& batch) {
+            std::vector<matlab::data::Array> values;
+            try {
+                const matlab::data::CellArray results(batch.result.get());
+                if (results.getNumberOfElements() != batch.calls.size()) {
+                    throw EngineException("The batch function must return one result per coalesced call.");
+                }
+                values.reserve(batch.calls.size());
+                for (size_t k = 0; k < batch.calls.size(); k++) {
+                    matlab::data::Array value = results[k];
+                    values.push_back(std::move(value));
+                }
+            }
+            catch (...) {
+                std::exception_ptr e = std::current_exception();
+                for (auto& call : batch.calls) {
+                    call->promise.set_exception(e);
+                    FutureExecutor::notifyCompletion(call->key);
+                }
+                return;
+            }
+            for (size_t k = 0; k < batch.calls.size(); k++) {
+                batch.calls[k]->promise.set_value(std::move(values[k]));
+                FutureExecutor::notifyCompletion(batch.calls[k]->key);
+            }
+        }
+    }
+}
+
+#endif /* FEVAL_BATCHER_IMPL_HPP */
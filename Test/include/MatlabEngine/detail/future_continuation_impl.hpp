@@ -0,0 +1,397 @@
+// future_continuation_impl.hpp : FutureExecutor and then() implementation
+
+#ifndef FUTURE_CONTINUATION_IMPL_HPP
+#define FUTURE_CONTINUATION_IMPL_HPP
+
+#include <map>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+#include "../future_continuation.hpp"
+#include "../value_future.hpp"
+#include "../task_reference.hpp"
+#include "../engine_exception.hpp"
+
+namespace matlab {
+    namespace engine {
+
+        inline FutureExecutor::FutureExecutor(size_t numThreads) : draining(false), pollRequested(false), stopping(false) {
+            if (numThreads == 0) {
+                numThreads = std::max<size_t>(2, std::thread::hardware_concurrency());
+            }
+            for (size_t i = 0; i < numThreads; i++) {
+                workers.push_back(std::thread(&FutureExecutor::workerLoop, this));
+            }
+            watcher = std::thread(&FutureExecutor::watcherLoop, this);
+            // Constructed before the executor returned by instance(), so that it outlives it
+            Registry& executors = registry();
+            std::lock_guard<std::mutex> lock(executors.mutex);
+            executors.executors.push_back(this);
+        }
+
+        inline FutureExecutor::~FutureExecutor() {
+            {
+                Registry& executors = registry();
+                std::lock_guard<std::mutex> lock(executors.mutex);
+                executors.executors.erase(std::find(executors.executors.begin(), executors.executors.end(), this));
+            }
+            {
+                std::lock_guard<std::mutex> lock(watchMutex);
+                stopping = true;
+            }
+            watchChanged.notify_one();
+            watcher.join();
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                draining = true;
+            }
+            taskReady.notify_all();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        inline FutureExecutor& FutureExecutor::instance() {
+            registry();
+            static FutureExecutor executor;
+            return executor;
+        }
+
+        inline FutureExecutor::Registry& FutureExecutor::registry() {
+            static Registry executors;
+            return executors;
+        }
+
+        inline void FutureExecutor::notifyCompletion(const void* key) {
+            Registry& executors = registry();
+            std::lock_guard<std::mutex> lock(executors.mutex);
+            for (FutureExecutor* executor : executors.executors) {
+                {
+                    std::lock_guard<std::mutex> watchLock(executor->watchMutex);
+                    if (key != nullptr) {
+                        executor->completed.push_back(key);
+                    }
+                    else {
+                        executor->pollRequested = true;
+                    }
+                }
+                executor->watchChanged.notify_one();
+            }
+        }
+
+        inline void FutureExecutor::notifyCompletion() {
+            notifyCompletion(nullptr);
+        }
+
+        inline void FutureExecutor::post(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                tasks.push_back(std::move(task));
+            }
+            taskReady.notify_one();
+        }
+
+        inline void FutureExecutor::whenReady(const void* key, std::function<bool()> isReady, std::function<void()> task) {
+            Watch watch = { key, std::move(isReady), std::move(task) };
+            {
+                std::lock_guard<std::mutex> lock(watchMutex);
+                added.push_back(std::move(watch));
+            }
+            watchChanged.notify_one();
+        }
+
+        inline void FutureExecutor::whenReady(std::function<bool()> isReady, std::function<void()> task) {
+            whenReady(nullptr, std::move(isReady), std::move(task));
+        }
+
+        inline void FutureExecutor::workerLoop() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(taskMutex);
+                    taskReady.wait(lock, [this]() { return !tasks.empty() || draining; });
+                    if (tasks.empty()) break;
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        inline void FutureExecutor::check(Watch& watch) {
+            bool ready;
+            try {
+                ready = watch.isReady();
+            }
+            catch (...) {
+                ready = true;
+            }
+            if (ready) {
+                post(std::move(watch.task));
+            }
+            else if (watch.key != nullptr) {
+                keyedWatches[watch.key].push_back(std::move(watch));
+            }
+            else {
+                polledWatches.push_back(std::move(watch));
+            }
+        }
+
+        inline void FutureExecutor::watcherLoop() {
+            const std::chrono::milliseconds pollInterval(10);
+            std::chrono::steady_clock::time_point nextPoll = std::chrono::steady_clock::now() + pollInterval;
+
+            std::unique_lock<std::mutex> lock(watchMutex);
+            while (!stopping) {
+                if (added.empty() && completed.empty() && !pollRequested) {
+                    if (polledWatches.empty()) {
+                        watchChanged.wait(lock);
+                    }
+                    else if (watchChanged.wait_until(lock, nextPoll) == std::cv_status::timeout) {
+                        pollRequested = true;
+                    }
+                    continue;
+                }
+
+                std::vector<Watch> newWatches;
+                newWatches.swap(added);
+                std::vector<const void*> keys;
+                keys.swap(completed);
+                bool poll = pollRequested;
+                pollRequested = false;
+                lock.unlock();
+
+                // A watch is filed under its key before the completions that follow are taken, so none is missed
+                for (auto& watch : newWatches) {
+                    check(watch);
+                }
+                for (const void* key : keys) {
+                    auto it = keyedWatches.find(key);
+                    if (it == keyedWatches.end()) continue;
+                    std::vector<Watch> woken;
+                    woken.swap(it->second);
+                    keyedWatches.erase(it);
+                    for (auto& watch : woken) {
+                        check(watch);
+                    }
+                }
+                if (poll) {
+                    std::vector<Watch> due;
+                    due.swap(polledWatches);
+                    for (auto& watch : due) {
+                        check(watch);
+                    }
+                    nextPoll = std::chrono::steady_clock::now() + pollInterval;
+                }
+
+                lock.lock();
+            }
+            keyedWatches.clear();
+            polledWatches.clear();
+        }
+
+        namespace detail {
+
+            template<class T>
+            inline bool isFutureReady(const FutureResult<T>& future) {
+                return future.wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+            }
+
+            inline const void* completionKey(const std::shared_ptr<TaskReference>& taskReference) {
+                return taskReference ? taskReference->getCompletionKey() : nullptr;
+            }
+
+            template<class T>
+            inline void checkValid(const std::vector<FutureResult<T>>& futures) {
+                for (auto& future : futures) {
+                    if (!future.valid()) {
+                        throw std::future_error(std::future_errc::no_state);
+                    }
+                }
+            }
+
+            template<class R>
+            struct ContinuationRunner {
+                template<class F, class A>
+                static void run(std::promise<R>& promise, F& func, A&& arg) {
+                    promise.set_value(func(std::forward<A>(arg)));
+                }
+            };
+
+            template<>
+            struct ContinuationRunner<void> {
+                template<class F, class A>
+                static void run(std::promise<void>& promise, F& func, A&& arg) {
+                    func(std::forward<A>(arg));
+                    promise.set_value();
+                }
+            };
+
+            template<class T, class R, class F>
+            struct ContinuationState {
+                ContinuationState(FutureResult<T>&& a_antecedent, F&& a_func, const void* a_key) : antecedent(std::move(a_antecedent)), func(std::move(a_func)), key(a_key) {}
+                ContinuationState(FutureResult<T>&& a_antecedent, const F& a_func, const void* a_key) : antecedent(std::move(a_antecedent)), func(a_func), key(a_key) {}
+
+                void run() {
+                    try {
+                        ContinuationRunner<R>::run(promise, func, std::move(antecedent));
+                    }
+                    catch (...) {
+                        promise.set_exception(std::current_exception());
+                    }
+                    FutureExecutor::notifyCompletion(key);
+                }
+
+                FutureResult<T> antecedent;
+                F func;
+                std::promise<R> promise;
+                const void* key;
+            };
+
+            // The TaskReference of a derived future: cancelling it cancels the antecedents, and its own address
+            // is the completion key
+            inline std::shared_ptr<TaskReference> forwardCancel(std::vector<std::shared_ptr<TaskReference>> antecedents) {
+                std::shared_ptr<TaskReference> reference = std::make_shared<TaskReference>([antecedents](uintptr_t, bool allowInterrupt) {
+                    bool cancelled = false;
+                    for (auto& antecedent : antecedents) {
+                        if (antecedent && antecedent->cancel(allowInterrupt)) {
+                            cancelled = true;
+                        }
+                    }
+                    return cancelled;
+                });
+                reference->setCompletionKey(reference.get());
+                return reference;
+            }
+
+            template<class T>
+            struct WhenAllState {
+                std::vector<FutureResult<T>> futures;
+                std::promise<std::vector<FutureResult<T>>> promise;
+                size_t next;
+                const void* key;
+
+                // Waits on the first future not yet ready, one at a time, so each wake-up is keyed by that future
+                static void await(const std::shared_ptr<WhenAllState>& state) {
+                    while (state->next < state->futures.size() && isFutureReady(state->futures[state->next])) {
+                        ++state->next;
+                    }
+                    if (state->next == state->futures.size()) {
+                        state->promise.set_value(std::move(state->futures));
+                        FutureExecutor::notifyCompletion(state->key);
+                        return;
+                    }
+                    FutureExecutor::instance().whenReady(completionKey(state->futures[state->next].getTaskReference()),
+                        [state]() { return isFutureReady(state->futures[state->next]); },
+                        [state]() { await(state); });
+                }
+            };
+
+            template<class T>
+            struct WhenAnyState {
+                std::mutex mutex;
+                std::vector<FutureResult<T>> futures;
+                std::promise<WhenAnyResult<T>> promise;
+                bool done;
+                const void* key;
+
+                // One watch per future, keyed by it; the first to find its future ready completes the result
+                bool isReady(size_t index) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return done || isFutureReady(futures[index]);
+                }
+
+                void complete(size_t index) {
+                    WhenAnyResult<T> result;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (done) return;
+                        done = true;
+                        result.index = index;
+                        result.futures = std::move(futures);
+                    }
+                    promise.set_value(std::move(result));
+                    FutureExecutor::notifyCompletion(key);
+                }
+            };
+        }
+
+        template<class T>
+        template<class F>
+        FutureResult<decltype(std::declval<F>()(std::declval<FutureResult<T>>()))> FutureResult<T>::then(F&& func) {
+            typedef decltype(std::declval<F>()(std::declval<FutureResult<T>>())) R;
+            typedef detail::ContinuationState<T, R, typename std::decay<F>::type> State;
+
+            // Checked here: a future without a state would only fail later, on the watcher thread
+            if (!valid()) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            const void* antecedentKey = detail::completionKey(taskReference);
+            std::shared_ptr<TaskReference> cancel = detail::forwardCancel({ taskReference });
+            std::shared_ptr<State> state = std::make_shared<State>(std::move(*this), std::forward<F>(func), cancel->getCompletionKey());
+            std::future<R> stdF = state->promise.get_future();
+            FutureExecutor::instance().whenReady(antecedentKey,
+                [state]() { return detail::isFutureReady(state->antecedent); },
+                [state]() { state->run(); });
+            return FutureResult<R>(std::move(stdF), cancel);
+        }
+
+        template <class T>
+        FutureResult<std::vector<FutureResult<T>>> when_all(std::vector<FutureResult<T>>&& futures) {
+            detail::checkValid(futures);
+            std::vector<std::shared_ptr<TaskReference>> antecedents;
+            for (auto& future : futures) {
+                antecedents.push_back(future.getTaskReference());
+            }
+            std::shared_ptr<TaskReference> cancel = detail::forwardCancel(std::move(antecedents));
+
+            std::shared_ptr<detail::WhenAllState<T>> state = std::make_shared<detail::WhenAllState<T>>();
+            state->futures = std::move(futures);
+            state->next = 0;
+            state->key = cancel->getCompletionKey();
+            std::future<std::vector<FutureResult<T>>> stdF = state->promise.get_future();
+            detail::WhenAllState<T>::await(state);
+            return FutureResult<std::vector<FutureResult<T>>>(std::move(stdF), cancel);
+        }
+
+        template <class T>
+        FutureResult<WhenAnyResult<T>> when_any(std::vector<FutureResult<T>>&& futures) {
+            detail::checkValid(futures);
+            std::vector<std::shared_ptr<TaskReference>> antecedents;
+            std::vector<const void*> keys;
+            for (auto& future : futures) {
+                antecedents.push_back(future.getTaskReference());
+                keys.push_back(detail::completionKey(antecedents.back()));
+            }
+            std::shared_ptr<TaskReference> cancel = detail::forwardCancel(std::move(antecedents));
+
+            std::shared_ptr<detail::WhenAnyState<T>> state = std::make_shared<detail::WhenAnyState<T>>();
+            state->futures = std::move(futures);
+            state->done = false;
+            state->key = cancel->getCompletionKey();
+            std::future<WhenAnyResult<T>> stdF = state->promise.get_future();
+            if (keys.empty()) {
+                state->promise.set_exception(std::make_exception_ptr(EngineException("when_any requires at least one future.")));
+            }
+            // The watches of the futures that lose stay until their futures complete or the executor stops
+            for (size_t i = 0; i < keys.size(); i++) {
+                FutureExecutor::instance().whenReady(keys[i],
+                    [state, i]() { return state->isReady(i); },
+                    [state, i]() { state->complete(i); });
+            }
+            return FutureResult<WhenAnyResult<T>>(std::move(stdF), cancel);
+        }
+    }
+}
+
+#endif /* FUTURE_CONTINUATION_IMPL_HPP */
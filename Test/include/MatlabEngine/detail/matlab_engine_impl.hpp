@@ -8,6 +8,10 @@
 #include <memory>
 #include <future>
 #include <complex>
+#include <atomic>
+#include <random>
+#include <cstdio>
+#include <cstdint>
 
 #include <MatlabDataArray/detail/HelperFunctions.hpp>
 #include "MatlabDataArray/StructArray.hpp"
@@ -18,6 +22,8 @@
 #include "MatlabDataArray/Reference.hpp"
 #include "../matlab_engine.hpp"
 #include "../engine_exception.hpp"
+#include "../future_continuation.hpp"
+#include "future_continuation_impl.hpp"
 
 namespace {
 
@@ -125,8 +131,53 @@ namespace {
         }
         break;
         }
+        matlab::engine::FutureExecutor::notifyCompletion(p);
         delete prom;
     }
+
+    // The promise passed to the completion callbacks is the completion key of its task
+    inline std::shared_ptr<matlab::engine::TaskReference> createTaskReference(uintptr_t handle, const void* promise) {
+        std::shared_ptr<matlab::engine::TaskReference> taskReference = std::make_shared<matlab::engine::TaskReference>(handle, &engine_cancel_feval_with_completion);
+        taskReference->setCompletionKey(promise);
+        return taskReference;
+    }
+
+    // Same as assigning through the element reference, whose setElement helper leaves a parameter unused
+    // and would warn in every translation unit that instantiates it
+    template <typename RefT>
+    inline void assignArray(const RefT& ref, const matlab::data::Array& value) {
+        matlab::data::detail::throwIfError(reference_set_reference_value(
+            matlab::data::detail::Access::getImpl<matlab::data::detail::ReferenceImpl>(ref),
+            matlab::data::detail::Access::getImpl<matlab::data::impl::ArrayImpl>(value)));
+    }
+
+    inline std::string bulkVariableName() {
+        // A per-process random prefix and a counter, so that names differ across clients of a shared session
+        static const uint64_t prefix = (static_cast<uint64_t>(std::random_device()()) << 32) | std::random_device()();
+        static std::atomic<uint64_t> counter(0);
+        char name[64];
+        snprintf(name, sizeof(name), "matlabEngineBulk_%016llx_%llu", static_cast<unsigned long long>(prefix),
+                 static_cast<unsigned long long>(counter++));
+        return name;
+    }
+
+    inline std::vector<std::string> checkVariableNames(const std::vector<matlab::engine::String>& varNames) {
+        std::vector<std::string> names;
+        names.reserve(varNames.size());
+        for (auto& varName : varNames) {
+            bool valid = !varName.empty() && varName.size() <= 63 &&
+                ((varName[0] >= u'a' && varName[0] <= u'z') || (varName[0] >= u'A' && varName[0] <= u'Z'));
+            for (size_t i = 1; valid && i < varName.size(); i++) {
+                char16_t c = varName[i];
+                valid = (c >= u'a' && c <= u'z') || (c >= u'A' && c <= u'Z') || (c >= u'0' && c <= u'9') || c == u'_';
+            }
+            if (!valid) {
+                throw matlab::engine::EngineException("Invalid MATLAB variable name.");
+            }
+            names.push_back(std::string(varName.begin(), varName.end()));
+        }
+        return names;
+    }
 }
 
 namespace matlab {
@@ -138,6 +189,7 @@ namespace matlab {
         inline void set_eval_promise_data(void *p) {
             std::promise<void>* prom = reinterpret_cast<std::promise<void>*>(p);
             prom->set_value();
+            FutureExecutor::notifyCompletion(p);
             delete prom;
         }
         
@@ -150,6 +202,7 @@ namespace matlab {
             if (nlhs == 0 && straight) {
                 std::promise<void>* prom = reinterpret_cast<std::promise<void>*>(p);
                 prom->set_value();
+                FutureExecutor::notifyCompletion(p);
                 delete prom;
                 return;
             }
@@ -158,6 +211,7 @@ namespace matlab {
                 std::promise<matlab::data::Array>* prom = reinterpret_cast<std::promise<matlab::data::Array>*>(p);
                 matlab::data::Array v_ = matlab::data::detail::Access::createObj<matlab::data::Array>(plhs[0]);
                 prom->set_value(v_);
+                FutureExecutor::notifyCompletion(p);
                 delete prom;
                 return;
             }
@@ -169,6 +223,7 @@ namespace matlab {
                 result.push_back(v_);
             }
             prom->set_value(result);
+            FutureExecutor::notifyCompletion(p);
             delete prom;
         }
 
@@ -351,13 +406,21 @@ namespace matlab {
         }
 
         inline matlab::data::Array MATLABEngine::getVariable(const String &varName, WorkspaceType workspaceType) {
-            return getVariableAsync(varName).get();
+            return getVariableAsync(varName, workspaceType).get();
         }
 
         inline void MATLABEngine::setVariable(const String &varName, const matlab::data::Array& var, WorkspaceType workspaceType) {
             return setVariableAsync(varName, var, workspaceType).get();
         }
 
+        inline std::vector<matlab::data::Array> MATLABEngine::getVariables(const std::vector<String> &varNames, WorkspaceType workspaceType) {
+            return getVariablesAsync(varNames, workspaceType).get();
+        }
+
+        inline void MATLABEngine::setVariables(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType) {
+            return setVariablesAsync(varNames, vars, workspaceType).get();
+        }
+
         inline matlab::data::Array MATLABEngine::getProperty(const matlab::data::Array &object, const String &propertyName) {
             return getPropertyAsync(object, propertyName).get();
         }
@@ -393,7 +456,7 @@ namespace matlab {
 
             uintptr_t handle = engine_feval_with_completion(matlabHandle, convertUTF16StringToUTF8String(function).c_str(), nlhs, false, argsImpl, nrhs, &set_feval_promise_data, &set_feval_promise_exception, p, output_, error_, &writeToStreamBuffer, &deleteStreamBufferImpl);
 
-            return FutureResult<std::vector<matlab::data::Array>>(std::move(f), std::make_shared<TaskReference>(handle, &engine_cancel_feval_with_completion));
+            return FutureResult<std::vector<matlab::data::Array>>(std::move(f), createTaskReference(handle, p));
         }
 
         inline FutureResult<matlab::data::Array> MATLABEngine::fevalAsync(const String &function,
@@ -415,7 +478,7 @@ namespace matlab {
 
             uintptr_t handle = engine_feval_with_completion(matlabHandle, convertUTF16StringToUTF8String(function).c_str(), 1, true, argsImpl, nrhs, &set_feval_promise_data, &set_feval_promise_exception, p, output_, error_, &writeToStreamBuffer, &deleteStreamBufferImpl);
 
-            return FutureResult<matlab::data::Array>(std::move(f), std::make_shared<TaskReference>(handle, &engine_cancel_feval_with_completion));
+            return FutureResult<matlab::data::Array>(std::move(f), createTaskReference(handle, p));
         }
 
         inline FutureResult<matlab::data::Array> MATLABEngine::fevalAsync(const String &function,
@@ -491,7 +554,7 @@ namespace matlab {
                 handlesV[i] = handles[i];
             }
             engine_destroy_handles(handles);
-            return FutureResult<void>(std::move(f), std::make_shared<TaskReference>(handlesV[0], &engine_cancel_feval_with_completion));
+            return FutureResult<void>(std::move(f), createTaskReference(handlesV[0], p));
         }
 
         namespace {
@@ -506,8 +569,11 @@ namespace matlab {
         }
         inline FutureResult<matlab::data::Array> MATLABEngine::getVariableAsync(const String &varName, WorkspaceType workspaceType) {
             matlab::data::ArrayFactory factory;
-            matlab::data::Array arg = factory.createCharArray(varName);
-            return fevalAsync(convertUTF8StringToUTF16String("matlab.internal.engine.getVariable"), arg, nullptr, nullptr);
+            std::string base = (workspaceType == WorkspaceType::BASE) ? std::string("base") : std::string("global");
+            std::vector<matlab::data::Array> args;
+            args.push_back(factory.createCharArray(varName));
+            args.push_back(factory.createCharArray(base));
+            return fevalAsync(convertUTF8StringToUTF16String("matlab.internal.engine.getVariable"), args, nullptr, nullptr);
         }
 
         inline FutureResult<void> MATLABEngine::setVariableAsync(const String &varName, const matlab::data::Array& var, WorkspaceType workspaceType) {
@@ -528,7 +594,77 @@ namespace matlab {
             std::promise<void>* p = new std::promise<void>();
             std::future<void> f = p->get_future();
             uintptr_t handle = engine_feval_with_completion(matlabHandle, "matlab.internal.engine.setVariable", 0, true, argsImpl, nrhs, &set_feval_promise_data, &set_feval_promise_exception, p, nullptr, nullptr, &writeToStreamBuffer, &deleteStreamBufferImpl);
-            return FutureResult<void>(std::move(f), std::make_shared<TaskReference>(handle, &engine_cancel_feval_with_completion));
+            return FutureResult<void>(std::move(f), createTaskReference(handle, p));
+        }
+
+        inline FutureResult<std::vector<matlab::data::Array>> MATLABEngine::getVariablesAsync(const std::vector<String> &varNames, WorkspaceType workspaceType) {
+            std::vector<std::string> names = checkVariableNames(varNames);
+            if (names.empty()) {
+                std::promise<std::vector<matlab::data::Array>> p;
+                p.set_value(std::vector<matlab::data::Array>());
+                return FutureResult<std::vector<matlab::data::Array>>(p.get_future());
+            }
+
+            // Global variables are not visible to an expression evaluated in the base workspace, and declaring
+            // them there would shadow base variables of the same name, so they are read through getVariable
+            std::string expression("struct(");
+            for (size_t i = 0; i < names.size(); i++) {
+                std::string value = (workspaceType == WorkspaceType::BASE) ? names[i] :
+                    "matlab.internal.engine.getVariable('" + names[i] + "', 'global')";
+                expression += (i == 0 ? "'" : ", '") + names[i] + "', {" + value + "}";
+            }
+            expression += ")";
+
+            matlab::data::ArrayFactory factory;
+            std::vector<matlab::data::Array> args;
+            args.push_back(factory.createCharArray("base"));
+            args.push_back(factory.createCharArray(expression));
+            return fevalAsync(convertUTF8StringToUTF16String("evalin"), args, nullptr, nullptr).then([names](FutureResult<matlab::data::Array> result) {
+                const matlab::data::StructArray packed(result.get());
+                std::vector<matlab::data::Array> vars;
+                vars.reserve(names.size());
+                for (auto& name : names) {
+                    vars.push_back(packed[0][name]);
+                }
+                return vars;
+            });
+        }
+
+        inline FutureResult<void> MATLABEngine::setVariablesAsync(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType) {
+            if (varNames.size() != vars.size()) {
+                throw EngineException("The number of variable names does not match the number of variables.");
+            }
+            std::vector<std::string> names = checkVariableNames(varNames);
+            if (names.empty()) {
+                std::promise<void> p;
+                p.set_value();
+                return FutureResult<void>(p.get_future());
+            }
+
+            matlab::data::ArrayFactory factory;
+            matlab::data::StructArray packed = factory.createStructArray({ 1, 1 }, names);
+            for (size_t i = 0; i < names.size(); i++) {
+                assignArray(packed[0][names[i]], vars[i]);
+            }
+
+            // The struct goes through a base workspace variable whose name is unique to this request, so that
+            // concurrent calls from other threads or clients of a shared session do not overwrite each other.
+            // The engine serves requests in order, so the unpacking statement and the clean-up can be queued
+            // right away. The clean-up is a request of its own rather than a try/catch in the statement, so it
+            // runs even when unpacking fails and no exception variable is bound in the caller's workspace
+            std::string temp = bulkVariableName();
+            std::string workspace = (workspaceType == WorkspaceType::BASE) ? std::string("base") : std::string("global");
+            std::string statement = "cellfun(@(n) matlab.internal.engine.setVariable(n, " + temp + ".(n), '" + workspace +
+                "'), fieldnames(" + temp + "))";
+            std::vector<FutureResult<void>> steps;
+            steps.push_back(setVariableAsync(convertUTF8StringToUTF16String(temp), packed, WorkspaceType::BASE));
+            steps.push_back(evalAsync(convertUTF8StringToUTF16String(statement), nullptr, nullptr));
+            steps.push_back(evalAsync(convertUTF8StringToUTF16String("clear " + temp), nullptr, nullptr));
+            return when_all(std::move(steps)).then([](FutureResult<std::vector<FutureResult<void>>> all) {
+                for (auto& step : all.get()) {
+                    step.get();
+                }
+            });
         }
 
         inline FutureResult<matlab::data::Array> MATLABEngine::getPropertyAsync(const matlab::data::Array &object, const String &propertyName) {
@@ -569,7 +705,7 @@ namespace matlab {
                 std::future<void> f = p->get_future();
                 uintptr_t handle = engine_feval_with_completion(matlabHandle, "matlab.internal.engine.setProperty", 0, true, argsImpl, nrhs, &set_feval_promise_data, &set_feval_promise_exception, p, nullptr, nullptr, &writeToStreamBuffer, &deleteStreamBufferImpl);
 
-                ret = std::move(FutureResult<void>(std::move(f), std::make_shared<TaskReference>(handle, &engine_cancel_feval_with_completion)));
+                ret = std::move(FutureResult<void>(std::move(f), createTaskReference(handle, p)));
             }
             else {
                 throw EngineException("The input variable is not a MATLAB object.");
@@ -0,0 +1,349 @@
+// mock_matlab_engine_impl.hpp : MockMATLABEngine implementation
+
+#ifndef MOCK_MATLAB_ENGINE_IMPL_HPP
+#define MOCK_MATLAB_ENGINE_IMPL_HPP
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <condition_variable>
+#include "../mock_matlab_engine.hpp"
+#include "../future_continuation.hpp"
+#include "../value_future.hpp"
+#include "../task_reference.hpp"
+#include "../engine_exception.hpp"
+
+namespace matlab {
+    namespace engine {
+
+        struct MockMATLABEngine::Request {
+            enum State {
+                QUEUED = 0,
+                RUNNING = 1,
+                CANCELLED = 2
+            };
+
+            Request() : state(QUEUED), key(nullptr) {}
+            virtual ~Request() {}
+
+            bool start() {
+                int expected = QUEUED;
+                return state.compare_exchange_strong(expected, RUNNING);
+            }
+
+            bool cancel() {
+                int expected = QUEUED;
+                if (!state.compare_exchange_strong(expected, CANCELLED)) {
+                    return false;
+                }
+                fail(std::make_exception_ptr(CancelledException("The request was cancelled before it started.")));
+                FutureExecutor::notifyCompletion(key);
+                return true;
+            }
+
+            virtual void run() = 0;
+            virtual void fail(std::exception_ptr e) = 0;
+
+            std::atomic<int> state;
+            const void* key;
+        };
+
+        template<class R>
+        struct MockMATLABEngine::TypedRequest : public MockMATLABEngine::Request {
+            TypedRequest(std::function<R()>&& a_body) : body(std::move(a_body)) {}
+
+            void run() override {
+                try {
+                    promise.set_value(body());
+                }
+                catch (...) {
+                    promise.set_exception(std::current_exception());
+                }
+            }
+
+            void fail(std::exception_ptr e) override {
+                promise.set_exception(e);
+            }
+
+            std::function<R()> body;
+            std::promise<R> promise;
+        };
+
+        template<>
+        inline void MockMATLABEngine::TypedRequest<void>::run() {
+            try {
+                body();
+                promise.set_value();
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+
+        inline MockMATLABEngine::MockMATLABEngine(const MockLatency& a_latency) :
+            latency(a_latency), jitterEngine(std::random_device()()), requests(0), stopping(false) {
+            server = std::thread(&MockMATLABEngine::serveLoop, this);
+        }
+
+        inline MockMATLABEngine::~MockMATLABEngine() {
+            std::deque<std::shared_ptr<Request>> abandoned;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                stopping = true;
+                abandoned.swap(queue);
+            }
+            queueReady.notify_all();
+            server.join();
+            for (auto& request : abandoned) {
+                request->cancel();
+            }
+        }
+
+        inline void MockMATLABEngine::registerFunction(const String &name, MockFunction function) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            functions[name] = std::move(function);
+        }
+
+        inline void MockMATLABEngine::registerStatement(const String &statement, MockStatement handler) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            statements[statement] = std::move(handler);
+        }
+
+        inline void MockMATLABEngine::setLatency(const MockLatency& a_latency) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            latency = a_latency;
+        }
+
+        inline uint64_t MockMATLABEngine::requestCount() const {
+            return requests.load();
+        }
+
+        inline std::vector<matlab::data::Array> MockMATLABEngine::feval(const String &function,
+                                                                        const size_t nlhs,
+                                                                        const std::vector<matlab::data::Array> &args,
+                                                                        const std::shared_ptr<StreamBuffer> &output,
+                                                                        const std::shared_ptr<StreamBuffer> &error) {
+            return fevalAsync(function, nlhs, args, output, error).get();
+        }
+
+        inline matlab::data::Array MockMATLABEngine::feval(const String &function,
+                                                           const std::vector<matlab::data::Array> &args,
+                                                           const std::shared_ptr<StreamBuffer> &output,
+                                                           const std::shared_ptr<StreamBuffer> &error) {
+            return fevalAsync(function, args, output, error).get();
+        }
+
+        inline matlab::data::Array MockMATLABEngine::feval(const String &function,
+                                                           const matlab::data::Array &arg,
+                                                           const std::shared_ptr<StreamBuffer> &output,
+                                                           const std::shared_ptr<StreamBuffer> &error) {
+            return fevalAsync(function, arg, output, error).get();
+        }
+
+        inline void MockMATLABEngine::eval(const String &statement,
+                                           const std::shared_ptr<StreamBuffer> &output,
+                                           const std::shared_ptr<StreamBuffer> &error) {
+            evalAsync(statement, output, error).get();
+        }
+
+        inline matlab::data::Array MockMATLABEngine::getVariable(const String &varName, WorkspaceType workspaceType) {
+            return getVariableAsync(varName, workspaceType).get();
+        }
+
+        inline void MockMATLABEngine::setVariable(const String &varName, const matlab::data::Array &var, WorkspaceType workspaceType) {
+            setVariableAsync(varName, var, workspaceType).get();
+        }
+
+        inline std::vector<matlab::data::Array> MockMATLABEngine::getVariables(const std::vector<String> &varNames, WorkspaceType workspaceType) {
+            return getVariablesAsync(varNames, workspaceType).get();
+        }
+
+        inline void MockMATLABEngine::setVariables(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType) {
+            setVariablesAsync(varNames, vars, workspaceType).get();
+        }
+
+        inline FutureResult<std::vector<matlab::data::Array>> MockMATLABEngine::fevalAsync(const String &function,
+                                                                                            const size_t nlhs,
+                                                                                            const std::vector<matlab::data::Array> &args,
+                                                                                            const std::shared_ptr<StreamBuffer> &/*output*/,
+                                                                                            const std::shared_ptr<StreamBuffer> &/*error*/) {
+            return post<std::vector<matlab::data::Array>>([this, function, nlhs, args]() {
+                return call(function, nlhs, args);
+            });
+        }
+
+        inline FutureResult<matlab::data::Array> MockMATLABEngine::fevalAsync(const String &function,
+                                                                              const std::vector<matlab::data::Array> &args,
+                                                                              const std::shared_ptr<StreamBuffer> &/*output*/,
+                                                                              const std::shared_ptr<StreamBuffer> &/*error*/) {
+            return post<matlab::data::Array>([this, function, args]() {
+                std::vector<matlab::data::Array> outputs = call(function, 1, args);
+                if (outputs.empty()) {
+                    throw MATLABExecutionException("MATLAB:TooManyOutputs", String(u"Too many output arguments."), std::vector<StackFrame>(), std::vector<MATLABExecutionException>());
+                }
+                return outputs.front();
+            });
+        }
+
+        inline FutureResult<matlab::data::Array> MockMATLABEngine::fevalAsync(const String &function,
+                                                                              const matlab::data::Array &arg,
+                                                                              const std::shared_ptr<StreamBuffer> &output,
+                                                                              const std::shared_ptr<StreamBuffer> &error) {
+            return fevalAsync(function, std::vector<matlab::data::Array>({ arg }), output, error);
+        }
+
+        inline FutureResult<void> MockMATLABEngine::evalAsync(const String &statement,
+                                                              const std::shared_ptr<StreamBuffer> &/*output*/,
+                                                              const std::shared_ptr<StreamBuffer> &/*error*/) {
+            return post<void>([this, statement]() {
+                MockStatement handler;
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    auto it = statements.find(statement);
+                    if (it != statements.end()) {
+                        handler = it->second;
+                    }
+                }
+                if (!handler) {
+                    throw MATLABExecutionException("MATLAB:mock:UnknownStatement", String(u"No handler is registered for the statement '") + statement + u"'.", std::vector<StackFrame>(), std::vector<MATLABExecutionException>());
+                }
+                handler(baseWorkspace);
+            });
+        }
+
+        inline FutureResult<matlab::data::Array> MockMATLABEngine::getVariableAsync(const String &varName, WorkspaceType workspaceType) {
+            return post<matlab::data::Array>([this, varName, workspaceType]() {
+                return lookup(varName, workspaceType);
+            });
+        }
+
+        inline FutureResult<void> MockMATLABEngine::setVariableAsync(const String &varName, const matlab::data::Array& var, WorkspaceType workspaceType) {
+            return post<void>([this, varName, var, workspaceType]() {
+                workspace(workspaceType)[varName] = var;
+            });
+        }
+
+        inline FutureResult<std::vector<matlab::data::Array>> MockMATLABEngine::getVariablesAsync(const std::vector<String> &varNames, WorkspaceType workspaceType) {
+            return post<std::vector<matlab::data::Array>>([this, varNames, workspaceType]() {
+                std::vector<matlab::data::Array> vars;
+                vars.reserve(varNames.size());
+                for (auto& varName : varNames) {
+                    vars.push_back(lookup(varName, workspaceType));
+                }
+                return vars;
+            });
+        }
+
+        inline FutureResult<void> MockMATLABEngine::setVariablesAsync(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType) {
+            if (varNames.size() != vars.size()) {
+                throw EngineException("The number of variable names does not match the number of variables.");
+            }
+            return post<void>([this, varNames, vars, workspaceType]() {
+                MockWorkspace& variables = workspace(workspaceType);
+                for (size_t i = 0; i < varNames.size(); i++) {
+                    variables[varNames[i]] = vars[i];
+                }
+            });
+        }
+
+        template<class R>
+        FutureResult<R> MockMATLABEngine::post(std::function<R()>&& body) {
+            std::shared_ptr<TypedRequest<R>> request = std::make_shared<TypedRequest<R>>(std::move(body));
+            std::future<R> stdF = request->promise.get_future();
+            std::weak_ptr<Request> weakRequest = request;
+            std::shared_ptr<TaskReference> taskReference = std::make_shared<TaskReference>([weakRequest](uintptr_t, bool) {
+                std::shared_ptr<Request> r = weakRequest.lock();
+                return r && r->cancel();
+            });
+            taskReference->setCompletionKey(taskReference.get());
+            request->key = taskReference.get();
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (stopping) {
+                    request->cancel();
+                }
+                else {
+                    queue.push_back(request);
+                }
+            }
+            queueReady.notify_one();
+            return FutureResult<R>(std::move(stdF), taskReference);
+        }
+
+        inline void MockMATLABEngine::serveLoop() {
+            for (;;) {
+                std::shared_ptr<Request> request;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueReady.wait(lock, [this]() { return !queue.empty() || stopping; });
+                    if (queue.empty()) break;
+                    request = std::move(queue.front());
+                    queue.pop_front();
+                }
+                if (!request->start()) continue;
+                injectLatency();
+                request->run();
+                ++requests;
+                FutureExecutor::notifyCompletion(request->key);
+            }
+        }
+
+        inline void MockMATLABEngine::injectLatency() {
+            std::chrono::microseconds delay;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                delay = latency.perRequest;
+                if (latency.jitter.count() > 0) {
+                    std::uniform_int_distribution<std::chrono::microseconds::rep> jitter(0, latency.jitter.count());
+                    delay += std::chrono::microseconds(jitter(jitterEngine));
+                }
+            }
+            if (delay.count() > 0) {
+                std::this_thread::sleep_for(delay);
+            }
+        }
+
+        inline std::vector<matlab::data::Array> MockMATLABEngine::call(const String &function, size_t nlhs, const std::vector<matlab::data::Array> &args) {
+            MockFunction implementation;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                auto it = functions.find(function);
+                if (it != functions.end()) {
+                    implementation = it->second;
+                }
+            }
+            if (!implementation) {
+                throw MATLABExecutionException("MATLAB:UndefinedFunction", String(u"Undefined function '") + function + u"'.", std::vector<StackFrame>(), std::vector<MATLABExecutionException>());
+            }
+            std::vector<matlab::data::Array> outputs = implementation(nlhs, args);
+            if (outputs.size() > nlhs) {
+                outputs.erase(outputs.begin() + nlhs, outputs.end());
+            }
+            return outputs;
+        }
+
+        inline matlab::data::Array MockMATLABEngine::lookup(const String &varName, WorkspaceType workspaceType) {
+            MockWorkspace& variables = workspace(workspaceType);
+            auto it = variables.find(varName);
+            if (it == variables.end()) {
+                throw MATLABExecutionException("MATLAB:UndefinedFunction", String(u"Undefined function or variable '") + varName + u"'.", std::vector<StackFrame>(), std::vector<MATLABExecutionException>());
+            }
+            return it->second;
+        }
+
+        inline MockWorkspace& MockMATLABEngine::workspace(WorkspaceType workspaceType) {
+            return workspaceType == WorkspaceType::GLOBAL ? globalWorkspace : baseWorkspace;
+        }
+    }
+}
+
+#endif /* MOCK_MATLAB_ENGINE_IMPL_HPP */
@@ -15,10 +15,12 @@ namespace matlab {
 
     namespace engine {
 
-        inline TaskReference::TaskReference() {}
-        inline TaskReference::TaskReference(std::function<bool(uintptr_t, bool)>&& cancel):handle(0), cancelImpl(std::move(cancel)){};
-        inline TaskReference::TaskReference(uintptr_t a_handle, std::function<bool(uintptr_t, bool)>&& cancel) :handle(a_handle), cancelImpl(std::move(cancel)) {};
+        inline TaskReference::TaskReference() : completionKey(nullptr) {}
+        inline TaskReference::TaskReference(std::function<bool(uintptr_t, bool)>&& cancel):handle(0), cancelImpl(std::move(cancel)), completionKey(nullptr){};
+        inline TaskReference::TaskReference(uintptr_t a_handle, std::function<bool(uintptr_t, bool)>&& cancel) :handle(a_handle), cancelImpl(std::move(cancel)), completionKey(nullptr) {};
         inline uintptr_t TaskReference::getHandle() const { return handle;  }
+        inline void TaskReference::setCompletionKey(const void* key) { completionKey = key; }
+        inline const void* TaskReference::getCompletionKey() const { return completionKey; }
         inline TaskReference::~TaskReference(){
             if(handle) engine_destroy_task_handle(handle);
         }
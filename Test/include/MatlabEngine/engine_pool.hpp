@@ -0,0 +1,273 @@
+// engine_pool.hpp : pool of shared MATLAB engine sessions
+
+#ifndef ENGINE_POOL_HPP
+#define ENGINE_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "engine_util.hpp"
+
+namespace matlab {
+
+    namespace engine {
+
+        template <class EngineT>
+        class BasicEnginePool;
+
+        /**
+        * Options used to configure an EnginePool
+        */
+        template <class EngineT>
+        struct BasicEnginePoolOptions {
+            BasicEnginePoolOptions() :
+                size(2),
+                maxCallsPerSession(0),
+                healthCheckInterval(std::chrono::seconds(30)),
+                startRetryDelay(std::chrono::seconds(5)) {}
+
+            /** The number of sessions kept started */
+            size_t size;
+
+            /** Startup options passed to startMATLAB when no factory is given */
+            std::vector<String> startupOptions;
+
+            /** Creates a session; defaults to startMATLAB(startupOptions) for MATLABEngine, and to the default
+            *   constructor for other engine types */
+            std::function<std::unique_ptr<EngineT>()> factory;
+
+            /** Statement evaluated once on every new session before it is leased; empty for none */
+            String prewarmScript;
+
+            /** Number of calls after which a session is recycled; 0 for no limit */
+            size_t maxCallsPerSession;
+
+            /** Statement evaluated on each session every healthCheckInterval while it is idle; empty for none */
+            String healthCheck;
+            std::chrono::milliseconds healthCheckInterval;
+
+            /** Delay before starting a session again after a failed start */
+            std::chrono::milliseconds startRetryDelay;
+        };
+
+        /**
+        * A snapshot of the state and counters of an EnginePool
+        */
+        struct EnginePoolMetrics {
+            size_t idle;
+            size_t leased;
+            size_t starting;
+
+            /** Sessions with a health check in flight; they are also counted as idle or leased */
+            size_t checking;
+
+            uint64_t leasesGranted;
+            uint64_t sessionsStarted;
+            uint64_t sessionsRecycled;
+            uint64_t startFailures;
+            uint64_t healthCheckFailures;
+
+            /** Total time callers spent blocked in lease() */
+            std::chrono::nanoseconds totalLeaseWait;
+
+            /**
+            * Get the fraction of ready sessions that are leased
+            *
+            * @return leased / (idle + leased), or 0 if no session is ready
+            */
+            double utilization() const {
+                size_t ready = idle + leased;
+                return ready == 0 ? 0.0 : static_cast<double>(leased) / static_cast<double>(ready);
+            }
+        };
+
+        /**
+        * Exclusive use of a pooled engine session. The session is handed back to the pool when the lease is
+        * destroyed or released. A lease counts as one call towards EnginePoolOptions::maxCallsPerSession
+        * unless more calls are recorded
+        */
+        template <class EngineT>
+        class BasicEngineLease {
+        public:
+            BasicEngineLease();
+            BasicEngineLease(BasicEngineLease&& rhs);
+            BasicEngineLease& operator=(BasicEngineLease&& rhs);
+            ~BasicEngineLease();
+
+            /**
+            * Check whether this lease holds a session
+            *
+            * @return true if a session is held; false otherwise
+            *
+            * @throw none
+            */
+            bool valid() const;
+
+            EngineT& operator*() const;
+            EngineT* operator->() const;
+            EngineT* get() const;
+
+            /**
+            * Record calls made through this lease
+            *
+            * @param count - The number of calls made
+            *
+            * @throw none
+            */
+            void recordCalls(size_t count);
+
+            /**
+            * Mark the session as failed so that it is recycled instead of being leased again
+            *
+            * @throw none
+            */
+            void reportError();
+
+            /**
+            * Hand the session back to the pool
+            *
+            * @throw none
+            */
+            void release();
+
+        private:
+            struct PooledEngine;
+            friend class BasicEnginePool<EngineT>;
+
+            BasicEngineLease(BasicEnginePool<EngineT>* pool, std::unique_ptr<PooledEngine>&& engine);
+            BasicEngineLease(const BasicEngineLease&) = delete;
+            BasicEngineLease& operator=(const BasicEngineLease&) = delete;
+
+            BasicEnginePool<EngineT>* pool;
+            std::unique_ptr<PooledEngine> engine;
+            size_t calls;
+            bool failed;
+        };
+
+        /**
+        * Keeps a number of MATLAB sessions started and prewarmed so that callers do not wait for startup.
+        * Sessions are recycled after a number of calls, after an error reported through the lease, or when
+        * the periodic health check fails; replacements are started in the background.
+        *
+        * Each start runs on its own thread and health checks are sent with evalAsync, so the maintenance
+        * thread never waits on MATLAB. A session stays leasable while it is being checked; if the check
+        * fails, the session is recycled at once when idle, or when its lease is released.
+        *
+        * The engine type needs eval and evalAsync, so a MockMATLABEngine can stand in for MATLABEngine.
+        */
+        template <class EngineT>
+        class BasicEnginePool {
+        public:
+            typedef EngineT engine_type;
+            typedef BasicEnginePoolOptions<EngineT> options_type;
+            typedef BasicEngineLease<EngineT> lease_type;
+
+
+            /**
+            * Constructor. Starts the sessions in the background
+            *
+            * @param options - The pool configuration
+            *
+            * @throw EngineException if the pool size is zero
+            */
+            explicit BasicEnginePool(const options_type& options);
+
+            /**
+            * Destructor. All leases must have been released. Cancels the health checks in flight and waits
+            * for the sessions being started
+            *
+            * @throw none
+            */
+            ~BasicEnginePool();
+
+            /**
+            * Lease a session, waiting until one is ready
+            *
+            * @return a valid EngineLease
+            *
+            * @throw EngineException if the pool is shutting down
+            */
+            lease_type lease();
+
+            /**
+            * Lease a session, waiting at most timeout for one to be ready
+            *
+            * @param timeout - The longest time to wait
+            * @return an EngineLease; not valid if no session became ready in time
+            *
+            * @throw EngineException if the pool is shutting down
+            */
+            lease_type tryLease(std::chrono::milliseconds timeout);
+
+            /**
+            * Wait until every session of the pool has been started and prewarmed
+            *
+            * @throw none
+            */
+            void waitUntilReady();
+
+            /**
+            * Get the current state and counters of the pool
+            *
+            * @return a snapshot of the metrics
+            *
+            * @throw none
+            */
+            EnginePoolMetrics metrics() const;
+
+        private:
+            typedef typename lease_type::PooledEngine PooledEngine;
+            friend class BasicEngineLease<EngineT>;
+
+            BasicEnginePool(const BasicEnginePool&) = delete;
+            BasicEnginePool& operator=(const BasicEnginePool&) = delete;
+
+            lease_type take(std::chrono::steady_clock::time_point start);
+            void giveBack(std::unique_ptr<PooledEngine>&& engine, size_t calls, bool failed);
+            std::unique_ptr<PooledEngine> startSession();
+            void startTask();
+            void checkDone(PooledEngine* engine, bool healthy);
+            void maintainLoop();
+            void startMissing();
+            void checkIdle();
+            void reapTasks();
+
+            options_type options;
+
+            mutable std::mutex mutex;
+            std::condition_variable engineAvailable;
+            std::condition_variable maintenanceNeeded;
+            std::vector<std::unique_ptr<PooledEngine>> idle;
+            std::vector<std::unique_ptr<PooledEngine>> retired;
+            EnginePoolMetrics counters;
+            std::chrono::steady_clock::time_point retryAfter;
+            bool stopping;
+
+            std::vector<std::future<void>> starts;
+            std::vector<FutureResult<void>> checks;
+            std::thread maintainer;
+        };
+
+        /**
+        * Options of a pool of MATLABEngine sessions
+        */
+        typedef BasicEnginePoolOptions<MATLABEngine> EnginePoolOptions;
+
+        /**
+        * Lease of a pooled MATLABEngine
+        */
+        typedef BasicEngineLease<MATLABEngine> EngineLease;
+
+        /**
+        * Pool of MATLABEngine sessions
+        */
+        typedef BasicEnginePool<MATLABEngine> EnginePool;
+    }
+}
+
+#endif /* ENGINE_POOL_HPP */
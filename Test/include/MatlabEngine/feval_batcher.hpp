@@ -0,0 +1,136 @@
+// feval_batcher.hpp : coalescing of small fevalAsync calls
+
+#ifndef FEVAL_BATCHER_HPP
+#define FEVAL_BATCHER_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "engine_util.hpp"
+#include <MatlabDataArray/TypedArray.hpp>
+
+namespace matlab {
+
+    namespace engine {
+
+        /**
+        * Coalesces many small fevalAsync calls to the same MATLAB function into one vectorized call.
+        *
+        * Calls are queued until either maxBatchSize calls are pending or the oldest pending call has
+        * waited maxDelay. The pending calls are then sent as a single request to batchFunction, which
+        * receives one 1xK cell array per argument position (K being the number of coalesced calls) and
+        * must return a 1xK cell array holding one result per call, e.g.
+        *
+        *     function out = batchFoo(varargin)
+        *         out = cellfun(@foo, varargin{:}, 'UniformOutput', false);
+        *     end
+        *
+        * A batch is submitted while the previous one is still in flight; results are scattered back to
+        * the individual futures in submission order.
+        *
+        * The engine type only needs a fevalAsync(const String&, const std::vector<matlab::data::Array>&)
+        * returning FutureResult<matlab::data::Array>, so a MockMATLABEngine can stand in for MATLABEngine.
+        */
+        template <class EngineT>
+        class BasicFevalBatcher {
+        public:
+            typedef EngineT engine_type;
+
+            /**
+            * Constructor
+            *
+            * @param engine - The engine used to evaluate the batches. It must outlive the batcher
+            * @param batchFunction - The name of the vectorized MATLAB function
+            * @param nrhs - The number of arguments of each individual call
+            * @param maxBatchSize - The maximum number of calls coalesced into one request
+            * @param maxDelay - The longest time a call is held back waiting for the batch to fill
+            *
+            * @throw EngineException if nrhs or maxBatchSize is zero
+            * @throw std::system_error if the batching threads cannot be started
+            */
+            BasicFevalBatcher(EngineT& engine,
+                         const String &batchFunction,
+                         size_t nrhs,
+                         size_t maxBatchSize = 256,
+                         std::chrono::milliseconds maxDelay = std::chrono::milliseconds(2));
+
+            /**
+            * Destructor. Submits all pending calls and waits for their results to be delivered
+            *
+            * @throw none
+            */
+            ~BasicFevalBatcher();
+
+            /**
+            * Queue a call to the batched MATLAB function
+            *
+            * @param args - The arguments of this call
+            * @return FutureResult<matlab::data::Array> - A future of the result of this call
+            *
+            * @throw EngineException if the number of arguments does not match nrhs
+            */
+            FutureResult<matlab::data::Array> fevalAsync(const std::vector<matlab::data::Array> &args);
+
+            /**
+            * Submit all pending calls without waiting for the batch to fill
+            *
+            * @throw none
+            */
+            void flush();
+
+            /**
+            * Get the number of calls queued but not yet submitted
+            *
+            * @return the number of pending calls
+            *
+            * @throw none
+            */
+            size_t pendingCount() const;
+
+        private:
+            struct Call;
+            struct Batch;
+
+            BasicFevalBatcher(const BasicFevalBatcher&) = delete;
+            BasicFevalBatcher& operator=(const BasicFevalBatcher&) = delete;
+
+            void submitLoop();
+            void collectLoop();
+            void submit(std::vector<std::shared_ptr<Call>>& calls);
+            void scatter(Batch& batch);
+            void stopSubmitter();
+
+            EngineT& engine;
+            String batchFunction;
+            size_t nrhs;
+            size_t maxBatchSize;
+            std::chrono::milliseconds maxDelay;
+
+            mutable std::mutex pendingMutex;
+            std::condition_variable pendingReady;
+            std::vector<std::shared_ptr<Call>> pending;
+            bool flushRequested;
+            bool stopping;
+
+            std::mutex inFlightMutex;
+            std::condition_variable inFlightReady;
+            std::deque<std::unique_ptr<Batch>> inFlight;
+            bool drained;
+
+            std::thread submitter;
+            std::thread collector;
+        };
+
+        /**
+        * Batcher of calls to a MATLABEngine
+        */
+        typedef BasicFevalBatcher<MATLABEngine> FevalBatcher;
+    }
+}
+
+#endif /* FEVAL_BATCHER_HPP */
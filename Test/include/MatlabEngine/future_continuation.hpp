@@ -0,0 +1,190 @@
+// future_continuation.hpp : continuations for engine futures
+
+#ifndef FUTURE_CONTINUATION_HPP
+#define FUTURE_CONTINUATION_HPP
+
+#include <map>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace matlab {
+
+    namespace engine {
+
+        template <class T>
+        class FutureResult;
+
+        /**
+        * Runs continuations of FutureResult objects.
+        *
+        * A single watcher thread checks the futures that continuations are waiting on when they complete,
+        * and hands each ready continuation to a fixed pool of worker threads. The number of threads is
+        * therefore independent of the number of requests in flight.
+        *
+        * Wake-ups are keyed by the completed task. MATLABEngine, MockMATLABEngine, FevalBatcher and the
+        * continuations themselves set a completion key on the TaskReference of each future they return, and
+        * call notifyCompletion with that key once the future is ready; only the continuations waiting on that
+        * future are then rechecked. Futures without a key, such as those completed by other producers, are
+        * rechecked every 10 ms and on every call to notifyCompletion() without a key.
+        */
+        class FutureExecutor {
+        public:
+
+            /**
+            * Constructor
+            *
+            * @param numThreads - The number of worker threads; 0 uses the hardware concurrency
+            *
+            * @throw none
+            */
+            explicit FutureExecutor(size_t numThreads = 0);
+
+            /**
+            * Destructor. Runs the tasks already posted; continuations still waiting are abandoned
+            *
+            * @throw none
+            */
+            ~FutureExecutor();
+
+            /**
+            * Get the executor shared by FutureResult::then, when_all and when_any
+            *
+            * @return the shared executor
+            *
+            * @throw none
+            */
+            static FutureExecutor& instance();
+
+            /**
+            * Wake the continuations that wait on the task with the given completion key, in all executors.
+            * Call after completing the promise of a future whose TaskReference carries that key
+            *
+            * @param key - The completion key of the completed task
+            *
+            * @throw none
+            */
+            static void notifyCompletion(const void* key);
+
+            /**
+            * Recheck the futures without a completion key in all executors, without waiting for the next
+            * 10 ms poll
+            *
+            * @throw none
+            */
+            static void notifyCompletion();
+
+            /**
+            * Run a task on a worker thread
+            *
+            * @param task - The task to run
+            *
+            * @throw none
+            */
+            void post(std::function<void()> task);
+
+            /**
+            * Run a task on a worker thread once a readiness check succeeds. The check is only ever called
+            * from the watcher thread: once when the task is registered, then after each call to
+            * notifyCompletion with the key or, for a nullptr key, every 10 ms. A check that throws counts as
+            * ready, so that the task sees the error
+            *
+            * @param key - The completion key of the task the check waits on, or nullptr to poll
+            * @param isReady - Returns true once the task can run without blocking
+            * @param task - The task to run
+            *
+            * @throw none
+            */
+            void whenReady(const void* key, std::function<bool()> isReady, std::function<void()> task);
+
+            /**
+            * Run a task on a worker thread once a readiness check, polled every 10 ms, succeeds
+            *
+            * @param isReady - Returns true once the task can run without blocking
+            * @param task - The task to run
+            *
+            * @throw none
+            */
+            void whenReady(std::function<bool()> isReady, std::function<void()> task);
+
+        private:
+            struct Watch {
+                const void* key;
+                std::function<bool()> isReady;
+                std::function<void()> task;
+            };
+
+            struct Registry {
+                std::mutex mutex;
+                std::vector<FutureExecutor*> executors;
+            };
+
+            FutureExecutor(const FutureExecutor&) = delete;
+            FutureExecutor& operator=(const FutureExecutor&) = delete;
+
+            void workerLoop();
+            void watcherLoop();
+            void check(Watch& watch);
+            static Registry& registry();
+
+            std::mutex taskMutex;
+            std::condition_variable taskReady;
+            std::deque<std::function<void()>> tasks;
+            bool draining;
+
+            // Handed to the watcher under watchMutex
+            std::mutex watchMutex;
+            std::condition_variable watchChanged;
+            std::vector<Watch> added;
+            std::vector<const void*> completed;
+            bool pollRequested;
+            bool stopping;
+
+            // Watcher thread only
+            std::map<const void*, std::vector<Watch>> keyedWatches;
+            std::vector<Watch> polledWatches;
+
+            std::vector<std::thread> workers;
+            std::thread watcher;
+        };
+
+        /**
+        * The result of when_any
+        */
+        template <class T>
+        struct WhenAnyResult {
+            size_t index;
+            std::vector<FutureResult<T>> futures;
+        };
+
+        /**
+        * Create a future that becomes ready when all of the given futures are ready
+        *
+        * @param futures - The futures to wait for
+        * @return a FutureResult holding the futures, all of them ready
+        *
+        * @throw std::future_error with std::future_errc::no_state if one of the futures is not valid
+        */
+        template <class T>
+        FutureResult<std::vector<FutureResult<T>>> when_all(std::vector<FutureResult<T>>&& futures);
+
+        /**
+        * Create a future that becomes ready when any of the given futures is ready
+        *
+        * @param futures - The futures to wait for
+        * @return a FutureResult holding the futures and the index of one that is ready
+        *
+        * @throw std::future_error with std::future_errc::no_state if one of the futures is not valid
+        */
+        template <class T>
+        FutureResult<WhenAnyResult<T>> when_any(std::vector<FutureResult<T>>&& futures);
+    }
+}
+
+#endif /* FUTURE_CONTINUATION_HPP */
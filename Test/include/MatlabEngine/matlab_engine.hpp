@@ -143,6 +143,27 @@ namespace matlab {
             * @throw none
             */
             void setVariable(const String &varName, const matlab::data::Array &var, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            /**
+            * Obtain several variables from the MATLAB base or global workspace in one request
+            *
+            * @param varNames - The names of MATLAB variables in the base or global workspace
+            * @return std::vector<matlab::data::Array> - The variables, in the order of varNames
+            *
+            * @throw EngineException if a name is not a valid MATLAB variable name; MATLABExecutionException
+            */
+            std::vector<matlab::data::Array> getVariables(const std::vector<String> &varNames, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            /**
+            * Send several variables to the MATLAB base or global workspace in one request
+            *
+            * @param varNames - The names of MATLAB variables in the base or global workspace
+            * @param vars - The variables to be sent, in the order of varNames
+            * @return none
+            *
+            * @throw EngineException if the sizes differ or a name is not a valid MATLAB variable name; MATLABExecutionException
+            */
+            void setVariables(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType = WorkspaceType::BASE);
             
             /**
             * Obtain the value of an object property
@@ -288,6 +309,30 @@ namespace matlab {
             */
             FutureResult<void> setVariableAsync(const String &varName, const matlab::data::Array& var, WorkspaceType workspaceType = WorkspaceType::BASE);
 
+            /**
+            * Obtain several variables from the MATLAB base or global workspace asynchronously. The variables are
+            * packed into a single struct by MATLAB and returned in one request
+            *
+            * @param varNames - The names of MATLAB variables in the base or global workspace
+            * @return FutureResult<std::vector<matlab::data::Array>> - A future to the variables, in the order of varNames
+            *
+            * @throw EngineException if a name is not a valid MATLAB variable name
+            */
+            FutureResult<std::vector<matlab::data::Array>> getVariablesAsync(const std::vector<String> &varNames, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            /**
+            * Send several variables to the MATLAB base or global workspace asynchronously. The variables are
+            * packed into a single struct, sent in one request to a uniquely named base workspace variable and
+            * unpacked into the workspace by a second request queued right behind it, which clears that variable
+            *
+            * @param varNames - The names of MATLAB variables in the base or global workspace
+            * @param vars - The variables to be sent, in the order of varNames
+            * @return FutureResult<void> - A future to the operation
+            *
+            * @throw EngineException if the sizes differ or a name is not a valid MATLAB variable name
+            */
+            FutureResult<void> setVariablesAsync(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType = WorkspaceType::BASE);
+
             /**
             * Obtain the value of an object property asynchronously
             *
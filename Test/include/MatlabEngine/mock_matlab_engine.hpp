@@ -0,0 +1,234 @@
+// mock_matlab_engine.hpp : in-process stand-in for a MATLAB engine session
+
+#ifndef MOCK_MATLAB_ENGINE_HPP
+#define MOCK_MATLAB_ENGINE_HPP
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <condition_variable>
+#include "engine_util.hpp"
+#include <MatlabDataArray/TypedArray.hpp>
+
+namespace matlab {
+
+    namespace engine {
+
+        /**
+        * The variables of a MockMATLABEngine workspace, by name
+        */
+        typedef std::map<String, matlab::data::Array> MockWorkspace;
+
+        /**
+        * A C++ function registered with a MockMATLABEngine. Called with the number of requested outputs and
+        * the arguments; returns the outputs
+        */
+        typedef std::function<std::vector<matlab::data::Array>(size_t nlhs, const std::vector<matlab::data::Array>& args)> MockFunction;
+
+        /**
+        * A statement registered with a MockMATLABEngine. Called with the base workspace
+        */
+        typedef std::function<void(MockWorkspace& base)> MockStatement;
+
+        /**
+        * Latency injected in every request handled by a MockMATLABEngine
+        */
+        struct MockLatency {
+            MockLatency() : perRequest(0), jitter(0) {}
+            MockLatency(std::chrono::microseconds a_perRequest, std::chrono::microseconds a_jitter = std::chrono::microseconds(0)) :
+                perRequest(a_perRequest), jitter(a_jitter) {}
+
+            /** Delay added to every request */
+            std::chrono::microseconds perRequest;
+
+            /** Upper bound of a uniformly distributed random delay added on top of perRequest */
+            std::chrono::microseconds jitter;
+        };
+
+        /**
+        * An in-process stand-in for MATLABEngine that does not need a running MATLAB session.
+        *
+        * The arguments and results are still matlab::data::Array values, created with
+        * matlab::data::ArrayFactory, so a program using the mock must link the MATLAB Data Array runtime
+        * (libMatlabDataArray.lib in Test/lib/win64/microsoft) and find its shared libraries at run time,
+        * which come with a MATLAB or MATLAB Runtime installation. A CI machine without one cannot run the
+        * mock; only the engine library, libMatlabEngine, is not needed.
+        *
+        * feval calls the C++ function registered under the function name, eval runs the statement registered
+        * under the exact statement text, and getVariable(s) / setVariable(s) operate on in-memory base and global
+        * workspaces. Like MATLAB, the mock handles one request at a time, in the order the requests were made,
+        * on its own thread; the configured latency is added to each request. Unknown functions, statements and
+        * variables fail with MATLABExecutionException.
+        *
+        * The mock offers the same member functions as MATLABEngine, so code written as a template over the
+        * engine type can be exercised against it, such as BasicFevalBatcher<MockMATLABEngine> and
+        * BasicEnginePool<MockMATLABEngine>. The mock prints nothing, so the output and error buffers are
+        * accepted but left empty.
+        */
+        class MockMATLABEngine {
+        public:
+
+            /**
+            * Constructor
+            *
+            * @param latency - The latency injected in every request
+            *
+            * @throw none
+            */
+            explicit MockMATLABEngine(const MockLatency& latency = MockLatency());
+
+            /**
+            * Destructor. Requests still queued are cancelled
+            *
+            * @throw none
+            */
+            ~MockMATLABEngine();
+
+            /**
+            * Register a function called by feval
+            *
+            * @param name - The function name
+            * @param function - The C++ implementation; replaces any function registered under the same name
+            *
+            * @throw none
+            */
+            void registerFunction(const String &name, MockFunction function);
+
+            /**
+            * Register a statement run by eval
+            *
+            * @param statement - The exact statement text
+            * @param handler - The C++ implementation; replaces any handler registered for the same statement
+            *
+            * @throw none
+            */
+            void registerStatement(const String &statement, MockStatement handler);
+
+            /**
+            * Change the latency injected in the requests that have not started yet
+            *
+            * @param latency - The new latency
+            *
+            * @throw none
+            */
+            void setLatency(const MockLatency& latency);
+
+            /**
+            * Get the number of requests handled so far, successful or not
+            *
+            * @return the number of requests
+            *
+            * @throw none
+            */
+            uint64_t requestCount() const;
+
+            std::vector<matlab::data::Array> feval(const String &function,
+                                                   const size_t nlhs,
+                                                   const std::vector<matlab::data::Array> &args,
+                                                   const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                                   const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            matlab::data::Array feval(const String &function,
+                                      const std::vector<matlab::data::Array> &args,
+                                      const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                      const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            matlab::data::Array feval(const String &function,
+                                      const matlab::data::Array &arg,
+                                      const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                      const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            void eval(const String &statement,
+                      const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                      const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            matlab::data::Array getVariable(const String &varName, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            void setVariable(const String &varName, const matlab::data::Array &var, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            std::vector<matlab::data::Array> getVariables(const std::vector<String> &varNames, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            void setVariables(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            FutureResult<std::vector<matlab::data::Array> > fevalAsync(const String &function,
+                                                                       const size_t nlhs,
+                                                                       const std::vector<matlab::data::Array> &args,
+                                                                       const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                                                       const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            FutureResult<matlab::data::Array> fevalAsync(const String &function,
+                                                         const std::vector<matlab::data::Array> &args,
+                                                         const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                                         const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            FutureResult<matlab::data::Array> fevalAsync(const String &function,
+                                                         const matlab::data::Array &arg,
+                                                         const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                                         const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            FutureResult<void> evalAsync(const String &statement,
+                                         const std::shared_ptr<StreamBuffer> &output = std::shared_ptr<StreamBuffer>(),
+                                         const std::shared_ptr<StreamBuffer> &error = std::shared_ptr<StreamBuffer>()
+            );
+
+            FutureResult<matlab::data::Array> getVariableAsync(const String &varName, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            FutureResult<void> setVariableAsync(const String &varName, const matlab::data::Array& var, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            FutureResult<std::vector<matlab::data::Array>> getVariablesAsync(const std::vector<String> &varNames, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+            FutureResult<void> setVariablesAsync(const std::vector<String> &varNames, const std::vector<matlab::data::Array> &vars, WorkspaceType workspaceType = WorkspaceType::BASE);
+
+        private:
+            struct Request;
+            template<class R>
+            struct TypedRequest;
+
+            MockMATLABEngine(const MockMATLABEngine&) = delete;
+            MockMATLABEngine& operator=(const MockMATLABEngine&) = delete;
+
+            template<class R>
+            FutureResult<R> post(std::function<R()>&& body);
+
+            void serveLoop();
+            void injectLatency();
+            std::vector<matlab::data::Array> call(const String &function, size_t nlhs, const std::vector<matlab::data::Array> &args);
+            matlab::data::Array lookup(const String &varName, WorkspaceType workspaceType);
+            MockWorkspace& workspace(WorkspaceType workspaceType);
+
+            std::mutex registryMutex;
+            std::map<String, MockFunction> functions;
+            std::map<String, MockStatement> statements;
+            MockLatency latency;
+
+            MockWorkspace baseWorkspace;
+            MockWorkspace globalWorkspace;
+            std::mt19937 jitterEngine;
+            std::atomic<uint64_t> requests;
+
+            std::mutex queueMutex;
+            std::condition_variable queueReady;
+            std::deque<std::shared_ptr<Request>> queue;
+            bool stopping;
+
+            std::thread server;
+        };
+    }
+}
+
+#endif /* MOCK_MATLAB_ENGINE_HPP */
@@ -39,6 +39,25 @@ namespace matlab {
             */
             uintptr_t getHandle() const;
 
+            /**
+            * Set the key that the producer of the task passes to FutureExecutor::notifyCompletion when the
+            * task completes, so that only the continuations waiting on this task are rechecked
+            *
+            * @param key - The completion key; nullptr leaves the continuations to be polled
+            *
+            * @throw none
+            */
+            void setCompletionKey(const void* key);
+
+            /**
+            * Get the completion key of the task
+            *
+            * @return the key set by the producer of the task, or nullptr
+            *
+            * @throw none
+            */
+            const void* getCompletionKey() const;
+
             virtual ~TaskReference();
 
             /**
@@ -55,6 +74,7 @@ namespace matlab {
             TaskReference& operator=(TaskReference&) = delete;
             uintptr_t handle;
             std::function<bool(uintptr_t, bool)> cancelImpl;
+            const void* completionKey;
             
         };
     }
@@ -7,6 +7,8 @@
 #include <streambuf>
 #include <memory>
 #include <future>
+#include <type_traits>
+#include <utility>
 
 namespace matlab {
 
@@ -164,6 +166,19 @@ namespace matlab {
             */
             std::shared_ptr<TaskReference> getTaskReference();
 
+            /**
+            * Attach a continuation that runs on the shared FutureExecutor once this future is ready.
+            * The calling thread is not blocked and no thread is parked waiting for the result.
+            * This future is moved into the continuation, which receives it ready so that get() does not block
+            *
+            * @param func - A callable taking FutureResult<T>
+            * @return a FutureResult of the value returned by func; cancelling it cancels this future
+            *
+            * @throw std::future_error with std::future_errc::no_state if this future is not valid
+            */
+            template<class F>
+            FutureResult<decltype(std::declval<F>()(std::declval<FutureResult<T>>()))> then(F&& func);
+
         private:
             FutureResult(std::future<T>&) = delete;
             FutureResult(const FutureResult&) = delete;
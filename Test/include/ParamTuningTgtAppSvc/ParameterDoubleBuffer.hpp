@@ -0,0 +1,133 @@
+// ParameterDoubleBuffer.hpp : double-buffered parameter block for lock-free tuning
+
+#ifndef ParameterDoubleBuffer_hpp
+#define ParameterDoubleBuffer_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Two copies of a model's parameter block. The model step reads the parameters only through active(); the
+// tuning thread writes a batch of changes into the other copy with stage() and hands it over with commit().
+// At its next step boundary the model calls publish(), which swaps the two pointers, so a step never sees a
+// half applied batch, never takes a lock and never copies parameter data however large the batch. Before the
+// next batch the tuning thread brings the new shadow copy up to date by copying back just the ranges the
+// previous batch changed.
+class ParameterDoubleBuffer
+{
+  public:
+    enum {
+        MAX_DIRTY_RANGES = 32
+    };
+
+    // Both blocks are size bytes; the active block holds the initial values and is copied to the shadow
+    ParameterDoubleBuffer(void *active, void *shadow, size_t size) :
+        active_(static_cast<uint8_t*>(active)), shadow_(static_cast<uint8_t*>(shadow)), size_(size),
+        dirtyCount_(0), dirtyOverflow_(false), published_(0)
+    {
+        memcpy(shadow_, active_, size_);
+        state_.store(STAGING, std::memory_order_relaxed);
+    }
+
+    // Model step thread
+
+    const void *active() const { return active_; }
+
+    // Returns true if a committed batch became active
+    bool publish() {
+        if (state_.load(std::memory_order_acquire) != COMMITTED) return false;
+        uint8_t *p = active_;
+        active_ = shadow_;
+        shadow_ = p;
+        ++published_;
+        state_.store(PUBLISHED, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t published() const { return published_; }
+
+    // Tuning thread
+
+    // Fails if the range is outside the block, or while a committed batch waits for publish()
+    bool stage(size_t offset, const void *data, size_t size) {
+        if (offset > size_ || size > size_ - offset) return false;
+        if (!beginStaging()) return false;
+        memcpy(shadow_ + offset, data, size);
+        markDirty(offset, size);
+        return true;
+    }
+
+    void commit() {
+        if (!beginStaging()) return;
+        if (dirtyCount_ == 0 && !dirtyOverflow_) return;
+        state_.store(COMMITTED, std::memory_order_release);
+    }
+
+    bool pending() const { return state_.load(std::memory_order_acquire) == COMMITTED; }
+
+  private:
+    enum State {
+        STAGING,    // the tuning thread owns the shadow block
+        COMMITTED,  // the shadow block waits for publish()
+        PUBLISHED   // swapped; the new shadow block lacks the last batch
+    };
+
+    struct Range {
+        size_t offset_;
+        size_t size_;
+    };
+
+    uint8_t *active_;
+    uint8_t *shadow_;
+    size_t size_;
+    Range dirty_[MAX_DIRTY_RANGES];
+    size_t dirtyCount_;
+    bool dirtyOverflow_;
+    uint32_t published_;
+    std::atomic<int> state_;
+
+    bool beginStaging() {
+        int s = state_.load(std::memory_order_acquire);
+        if (s == COMMITTED) return false;
+        if (s == PUBLISHED) {
+            // Both threads only read the active block here
+            if (dirtyOverflow_) {
+                memcpy(shadow_, active_, size_);
+            } else {
+                for (size_t i = 0; i < dirtyCount_; ++i) {
+                    memcpy(shadow_ + dirty_[i].offset_, active_ + dirty_[i].offset_, dirty_[i].size_);
+                }
+            }
+            dirtyCount_ = 0;
+            dirtyOverflow_ = false;
+            state_.store(STAGING, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    void markDirty(size_t offset, size_t size) {
+        if (dirtyOverflow_ || size == 0) return;
+        // Extend the last range when writes are contiguous, which is the common case for a batch
+        if (dirtyCount_ != 0) {
+            Range &last = dirty_[dirtyCount_ - 1];
+            if (offset >= last.offset_ && offset <= last.offset_ + last.size_) {
+                size_t end = offset + size > last.offset_ + last.size_ ? offset + size : last.offset_ + last.size_;
+                last.size_ = end - last.offset_;
+                return;
+            }
+        }
+        if (dirtyCount_ == MAX_DIRTY_RANGES) {
+            dirtyOverflow_ = true;
+            return;
+        }
+        dirty_[dirtyCount_].offset_ = offset;
+        dirty_[dirtyCount_].size_ = size;
+        ++dirtyCount_;
+    }
+
+    ParameterDoubleBuffer(const ParameterDoubleBuffer &);
+    const ParameterDoubleBuffer& operator=(const ParameterDoubleBuffer &);
+};
+
+#endif
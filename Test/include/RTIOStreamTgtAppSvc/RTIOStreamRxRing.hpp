@@ -0,0 +1,64 @@
+// RTIOStreamRxRing.hpp : byte ring for the rtiostream receive path
+
+#ifndef RTIOStreamRxRing_hpp
+#define RTIOStreamRxRing_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include "coder/target_services/Message.hpp"
+#include "coder/target_services/spsc_fifo.hpp"
+
+#ifndef RTIOSTREAM_RX_RING_SIZE
+#define RTIOSTREAM_RX_RING_SIZE 8192
+#endif
+
+// Byte stream receive path. The comm service thread copies each received payload into the ring and frees the
+// message at once, so a slow reader holds bytes rather than whole message buffers; the reader takes any
+// number of bytes at a time, or looks at them in place with peek()/consume(). N must be a power of two.
+template <size_t N = RTIOSTREAM_RX_RING_SIZE>
+class RTIOStreamRxRing
+{
+  public:
+    RTIOStreamRxRing() {}
+
+    // Comm service thread. Appends the payload from byte skip on and deletes the message; if the ring has no
+    // room for all of it, nothing is copied and the caller keeps the message.
+    bool put(coder::tgtsvc::Message *message, size_t skip = 0)
+    {
+        size_t size = message->payloadSize() > skip ? message->payloadSize() - skip : 0;
+        if (ring_.space() < size) return false;
+        ring_.push(message->payload() + skip, size);
+        delete message;
+        return true;
+    }
+
+    // Reader thread
+
+    size_t available() const { return ring_.contents_size(); }
+
+    size_t read(void *data, size_t size)
+    {
+        return ring_.pop(static_cast<uint8_t*>(data), size);
+    }
+
+    // Bytes readable in place, up to the end of the ring; call again after consume() for the rest
+    size_t peek(const uint8_t *&data)
+    {
+        typename coder::tgtsvc::detail::spsc_fifo<uint8_t, N>::carray c = ring_.contents_carray();
+        data = c.addr_;
+        return c.size_;
+    }
+
+    void consume(size_t size)
+    {
+        ring_.contents_remove(size);
+    }
+
+  private:
+    coder::tgtsvc::detail::spsc_fifo<uint8_t, N> ring_;
+
+    RTIOStreamRxRing(const RTIOStreamRxRing &);
+    const RTIOStreamRxRing& operator=(const RTIOStreamRxRing &);
+};
+
+#endif
@@ -0,0 +1,218 @@
+// ToAsyncQueueBatcher.hpp : coalescing of logged samples into batch messages
+
+#ifndef ToAsyncQueueBatcher_hpp
+#define ToAsyncQueueBatcher_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "coder/target_services/Application.hpp"
+#include "coder/target_services/Message.hpp"
+#include "coder/target_services/LinkCounters.hpp"
+#include "coder/target_services/LinkCapabilities.hpp"
+#include "coder/target_services/MessageDictionary.hpp"
+
+#ifndef TOASYNCQUEUE_BATCHER_MAX_SIGNALS
+#define TOASYNCQUEUE_BATCHER_MAX_SIGNALS 16
+#endif
+
+// Header at the start of a batch payload. The samples follow back to back. The first was logged at t0_ and every
+// later one step_ after the one before it, the time being accumulated in double: t(i) = t(i-1) + step_. The
+// sender only batches samples whose times that sum reproduces exactly, so a fixed-step signal costs no bytes per
+// sample for its time stamps and the host gets the logged times bit for bit.
+struct ToAsyncQueueBatchHeader
+{
+    double t0_;
+    double step_;
+    uint32_t id_;
+    uint32_t sampleSize_;
+    uint32_t count_;
+    uint32_t reserved_;
+};
+
+// Coalesces the samples of each signal into one TO_ASYNC_QUEUE_ID message instead of one message per sample.
+// A batch is sent when it is full, when the next time is not exactly one step on, or by poll() once it is older
+// than maxLatencyMs. CommService provides TSEStatus sendMessage(Message*); a batch it refuses is dropped and
+// counted.
+//
+// Batch messages are only sent once the host has agreed to CapabilitiesMsg::CAP_BATCHING on this connection.
+// Until then sendData() returns false and the caller sends the sample the usual way, with
+// ToAsyncQueueTgtAppSvc::sendData.
+template <class CommService, size_t MAX_SIGNALS = TOASYNCQUEUE_BATCHER_MAX_SIGNALS>
+class ToAsyncQueueBatcher
+{
+  public:
+    enum {
+        BATCH_DATA_FUN = 0x40
+    };
+
+    ToAsyncQueueBatcher(CommService &comm, uint16_t maxPayload, uint32_t maxLatencyMs) :
+        comm_(comm), maxPayload_(maxPayload), maxLatencyMs_(maxLatencyMs), dropped_(0), last_(0) {}
+
+    ~ToAsyncQueueBatcher() { flush(); }
+
+    bool sendData(uint32_t id, double time, const void *data, uint32_t sizeOfData, uint32_t nowMs) {
+        if (!coder::tgtsvc::LinkCapabilities::instance().agreed(coder::tgtsvc::CapabilitiesMsg::CAP_BATCHING)) {
+            // Batches opened under an earlier agreement would not be understood after a reconnect
+            discard();
+            return false;
+        }
+        if (maxPayload_ < sizeof(ToAsyncQueueBatchHeader) ||
+            sizeOfData > maxPayload_ - sizeof(ToAsyncQueueBatchHeader)) {
+            drop();
+            return true;
+        }
+        Slot *s = find(id);
+        if (s != NULL && !s->accepts(time, sizeOfData, maxPayload_)) {
+            send(*s);
+        }
+        if (s == NULL) {
+            s = vacant();
+        }
+        if (s->message_ == NULL && !open(*s, id, time, sizeOfData, nowMs)) {
+            drop();
+            return true;
+        }
+        s->append(time, data);
+        return true;
+    }
+
+    // Send the batches opened more than maxLatencyMs before nowMs
+    void poll(uint32_t nowMs) {
+        for (size_t i = 0; i < MAX_SIGNALS; ++i) {
+            Slot &s = slots_[i];
+            if (s.message_ != NULL && (uint32_t)(nowMs - s.openedMs_) >= maxLatencyMs_) send(s);
+        }
+    }
+
+    void flush() {
+        for (size_t i = 0; i < MAX_SIGNALS; ++i) {
+            if (slots_[i].message_ != NULL) send(slots_[i]);
+        }
+    }
+
+    // Batches or samples lost to allocation or send failures
+    uint32_t dropped() const { return dropped_; }
+
+    // Host side: call f(id, time, data, size) for every sample of a batch message
+    template <typename F>
+    static bool forEachSample(const coder::tgtsvc::Message *message, F f) {
+        ToAsyncQueueBatchHeader h;
+        if (message->appFun() != BATCH_DATA_FUN || message->payloadSize() < sizeof(h)) return false;
+        memcpy(&h, message->payload(), sizeof(h));
+        if ((uint64_t)h.count_ * h.sampleSize_ != message->payloadSize() - sizeof(h)) return false;
+        const uint8_t *p = message->payload() + sizeof(h);
+        double time = h.t0_;
+        for (uint32_t i = 0; i < h.count_; ++i, p += h.sampleSize_, time += h.step_) {
+            f(h.id_, time, p, h.sampleSize_);
+        }
+        return true;
+    }
+
+  private:
+    struct Slot {
+        Slot() : message_(NULL), id_(0), lastTime_(0), openedMs_(0) {}
+
+        ToAsyncQueueBatchHeader &header() {
+            return *reinterpret_cast<ToAsyncQueueBatchHeader*>(message_->payload());
+        }
+
+        bool accepts(double time, uint32_t size, uint16_t maxPayload) {
+            if (message_ == NULL) return true;
+            ToAsyncQueueBatchHeader &h = header();
+            if (size != h.sampleSize_ || message_->payloadSize() + size > maxPayload) return false;
+            if (h.count_ == 0) return true;
+            // The host adds the step to the previous time, so the sum must give this time exactly
+            double step = h.count_ == 1 ? time - lastTime_ : h.step_;
+            return lastTime_ + step == time;
+        }
+
+        void append(double time, const void *data) {
+            ToAsyncQueueBatchHeader &h = header();
+            if (h.count_ == 1) h.step_ = time - h.t0_;
+            memcpy(message_->payload() + message_->payloadSize(), data, h.sampleSize_);
+            message_->payloadSize((uint16_t)(message_->payloadSize() + h.sampleSize_));
+            ++h.count_;
+            lastTime_ = time;
+        }
+
+        coder::tgtsvc::Message *message_;
+        uint32_t id_;
+        double lastTime_;
+        uint32_t openedMs_;
+    };
+
+    CommService &comm_;
+    uint16_t maxPayload_;
+    uint32_t maxLatencyMs_;
+    uint32_t dropped_;
+    size_t last_;
+    Slot slots_[MAX_SIGNALS];
+
+    Slot *find(uint32_t id) {
+        if (slots_[last_].message_ != NULL && slots_[last_].id_ == id) return &slots_[last_];
+        for (size_t i = 0; i < MAX_SIGNALS; ++i) {
+            if (slots_[i].message_ != NULL && slots_[i].id_ == id) return &slots_[last_ = i];
+        }
+        return NULL;
+    }
+
+    // An empty slot, or else the one holding the oldest batch, sent first
+    Slot *vacant() {
+        size_t oldest = 0;
+        for (size_t i = 0; i < MAX_SIGNALS; ++i) {
+            if (slots_[i].message_ == NULL) return &slots_[last_ = i];
+            if ((int32_t)(slots_[i].openedMs_ - slots_[oldest].openedMs_) < 0) oldest = i;
+        }
+        send(slots_[oldest]);
+        return &slots_[last_ = oldest];
+    }
+
+    bool open(Slot &s, uint32_t id, double time, uint32_t sampleSize, uint32_t nowMs) {
+        s.message_ = coder::tgtsvc::Message::alloc(maxPayload_);
+        if (s.message_ == NULL) return false;
+        s.message_->payloadSize((uint16_t)sizeof(ToAsyncQueueBatchHeader));
+        s.message_->appId(coder::tgtsvc::Application::TO_ASYNC_QUEUE_ID);
+        s.message_->appFun(BATCH_DATA_FUN);
+        ToAsyncQueueBatchHeader &h = s.header();
+        h.t0_ = time;
+        h.step_ = 0;
+        h.id_ = id;
+        h.sampleSize_ = sampleSize;
+        h.count_ = 0;
+        h.reserved_ = 0;
+        s.id_ = id;
+        s.openedMs_ = nowMs;
+        return true;
+    }
+
+    void send(Slot &s) {
+        if (comm_.sendMessage(s.message_) != coder::tgtsvc::TSE_SUCCESS) {
+            delete s.message_;
+            drop();
+        }
+        s.message_ = NULL;
+    }
+
+    // Drop the open batches without sending them
+    void discard() {
+        for (size_t i = 0; i < MAX_SIGNALS; ++i) {
+            if (slots_[i].message_ != NULL) {
+                delete slots_[i].message_;
+                slots_[i].message_ = NULL;
+                drop();
+            }
+        }
+    }
+
+    // Counted here and, for the heartbeat, in LinkCounters
+    void drop() {
+        ++dropped_;
+        coder::tgtsvc::LinkCounters::instance().dropped(coder::tgtsvc::Application::TO_ASYNC_QUEUE_ID);
+    }
+
+    ToAsyncQueueBatcher(const ToAsyncQueueBatcher &);
+    const ToAsyncQueueBatcher& operator=(const ToAsyncQueueBatcher &);
+};
+
+#endif
@@ -0,0 +1,161 @@
+// ApplicationDispatcher.hpp : per-application dispatch lanes
+
+#ifndef coder_tgtsvc_ApplicationDispatcher_hpp
+#define coder_tgtsvc_ApplicationDispatcher_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Application.hpp"
+#include "Message.hpp"
+#include "StatusFlags.hpp"
+#include "LinkCounters.hpp"
+#include "spsc_fifo.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Alternative to calling Application::dispatch on the receive thread. Every application selected at start()
+// gets a bounded queue of N messages and a worker thread that calls its handleMessage, so a slow handler only
+// delays its own messages. Messages for the other applications are still dispatched inline. When a queue is
+// full, dispatch() sets StatusFlags::APP_QUEUE_FULL and returns TSE_RESOURCE_UNAVAILABLE without taking the
+// message; the receive thread decides whether to drop it or offer it again later, and the other applications
+// keep being served meanwhile. dispatch() must always be called from the same thread.
+template<size_t N = 64>
+class ApplicationDispatcher
+{
+public:
+
+    ApplicationDispatcher() : running_(false) {}
+
+    ~ApplicationDispatcher() { stop(); }
+
+    // queuedMask has bit i set for every application id i that should get its own worker. The applications
+    // must already be enabled and stay enabled until stop().
+    void start(uint32_t queuedMask) {
+        assert(!running_);
+        for (uint8_t id = 0; id < Application::APPLICATION_COUNT; ++id) {
+            Application *app = Application::findById(id);
+            if (app != NULL && (queuedMask & (1u << id)) != 0) {
+                lanes_[id].start(app);
+            }
+        }
+        running_ = true;
+    }
+
+    // Handlers see every message queued before the call
+    void stop() {
+        if (!running_) return;
+        for (uint8_t id = 0; id < Application::APPLICATION_COUNT; ++id) {
+            lanes_[id].stop();
+        }
+        running_ = false;
+    }
+
+    // Every message taken is counted as received in LinkCounters
+    TSEStatus dispatch(Message *message) {
+        uint8_t id = message->appId();
+        Lane *lane = id < Application::APPLICATION_COUNT ? &lanes_[id] : NULL;
+        if (lane == NULL || !lane->started()) {
+            LinkCounters::instance().received(id);
+            Application::dispatch(message);
+            return TSE_SUCCESS;
+        }
+        if (!lane->push(message)) {
+            StatusFlags::instance().set(StatusFlags::APP_QUEUE_FULL);
+            return TSE_RESOURCE_UNAVAILABLE;
+        }
+        LinkCounters::instance().received(id);
+        return TSE_SUCCESS;
+    }
+
+    // Number of messages refused because the application's queue was full; dispatching thread only
+    uint32_t refused(uint8_t id) const {
+        assert(id < Application::APPLICATION_COUNT);
+        return lanes_[id].refused();
+    }
+
+private:
+
+    class Lane
+    {
+    public:
+        Lane() : app_(NULL), stopping_(false), sleeping_(false), refused_(0) {}
+
+        bool started() const { return app_ != NULL; }
+
+        void start(Application *app) {
+            app_ = app;
+            stopping_ = false;
+            refused_ = 0;
+            worker_ = std::thread(&Lane::run, this);
+        }
+
+        void stop() {
+            if (!started()) return;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            worker_.join();
+            app_ = NULL;
+        }
+
+        bool push(Message *message) {
+            if (!queue_.push(message)) {
+                ++refused_;
+                return false;
+            }
+            // Pairs with the fence in run(): either the worker sees the message or this sees it asleep
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                wake_.notify_one();
+            }
+            return true;
+        }
+
+        uint32_t refused() const { return refused_; }
+
+    private:
+        Application *app_;
+        detail::spsc_fifo<Message*, N> queue_;
+        std::thread worker_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stopping_;
+        std::atomic<bool> sleeping_;
+        uint32_t refused_;
+
+        void run() {
+            for (;;) {
+                Message *message;
+                while (queue_.pop(message)) {
+                    app_->handleMessage(message);
+                }
+                std::unique_lock<std::mutex> lock(mutex_);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                while (queue_.empty() && !stopping_) wake_.wait(lock);
+                sleeping_.store(false, std::memory_order_relaxed);
+                if (queue_.empty() && stopping_) return;
+            }
+        }
+
+        Lane(const Lane &);
+        Lane &operator=(const Lane &);
+    };
+
+    Lane lanes_[Application::APPLICATION_COUNT];
+    bool running_;
+
+    ApplicationDispatcher(const ApplicationDispatcher &);
+    ApplicationDispatcher &operator=(const ApplicationDispatcher &);
+};
+
+}}
+
+#endif
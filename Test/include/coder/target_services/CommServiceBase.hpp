@@ -8,6 +8,8 @@
 #include "Application.hpp"
 #include "Atomic.hpp"
 #include "MessageDictionary.hpp"
+#include "LinkCapabilities.hpp"
+#include "PayloadCompressor.hpp"
 
 namespace coder { namespace tgtsvc {
 
@@ -98,6 +100,7 @@ protected:
             break;
 
         case ConnectMsg::ID:
+            LinkCapabilities::instance().reset();
             new (message) ConnectResponseMsg;
             sendMessage(message);
             connected_ = true;
@@ -114,6 +117,37 @@ protected:
                 break;
             }
 
+        case HeartbeatExMsg::ID:
+            {
+                // The request has no payload and may be too small for the response
+                delete message;
+                Message *m = Message::alloc(HeartbeatExResponseMsg::PAYLOAD_SIZE);
+                if (m == NULL) break;
+                HeartbeatExResponseMsg *hrm = new (m) HeartbeatExResponseMsg;
+                LinkCounters::instance().snapshot(hrm->counters_);
+                hrm->counters_.statusFlags_ = StatusFlags::instance().bits_;
+                if (sendMessage(hrm) != TSE_SUCCESS) delete hrm;
+                break;
+            }
+
+        case CapabilitiesMsg::ID:
+            {
+                CapabilitiesMsg *cm = static_cast<CapabilitiesMsg*>(message);
+                uint32_t agreed = cm->capabilities_ & (CapabilitiesMsg::CAP_COMPRESSION | CapabilitiesMsg::CAP_BATCHING);
+                LinkCapabilities::instance().agree(agreed, cm->compressedApps_, cm->compressionThreshold_);
+                CapabilitiesResponseMsg *crm = new (message) CapabilitiesResponseMsg;
+                crm->capabilities_ = agreed;
+                sendMessage(crm);
+                break;
+            }
+
+        case CompressedMsg::ID:
+            {
+                Message *m = PayloadCompressor::inflate(message);
+                if (m != NULL) Application::dispatch(m);
+                break;
+            }
+
         case InTestStartMsg::ID:
             {
                 InTestStartMsg *itsm = static_cast<InTestStartMsg*>(message);
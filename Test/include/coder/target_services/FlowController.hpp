@@ -0,0 +1,95 @@
+// FlowController.hpp : host side credit flow control fed by the target's link counters
+
+#ifndef coder_tgtsvc_FlowController_hpp
+#define coder_tgtsvc_FlowController_hpp
+
+#include <stdint.h>
+#include "Application.hpp"
+#include "LinkCounters.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Host side credit-based flow control for the messages sent to target applications, fed with the
+// LinkCountersSnapshot of every HeartbeatExResponseMsg. Each application may send up to window() messages
+// between two heartbeats, and each heartbeat hands out a new set of credits. The window grows by one message if
+// its credits ran out and the target reported no trouble, and is halved when, since the previous heartbeat, the
+// target
+// - failed to allocate message memory (all applications),
+// - dropped messages or data of the application, or
+// - had its posted queues more than highWater percent full (all applications),
+// so senders slow down before the target's buffers overflow.
+//
+// Until the first snapshot arrives, for instance when the target does not answer HeartbeatExMsg, nothing is
+// throttled. The credits do not wait for the target's received counts, which a target dispatching through the
+// prebuilt comm service loop never reports.
+class FlowController
+{
+public:
+    enum {
+        DEFAULT_MIN_WINDOW = 1,
+        DEFAULT_MAX_WINDOW = 256,
+        DEFAULT_INITIAL_WINDOW = 16,
+        DEFAULT_HIGH_WATER = 75
+    };
+
+    FlowController(uint32_t minWindow = DEFAULT_MIN_WINDOW, uint32_t maxWindow = DEFAULT_MAX_WINDOW,
+                   uint32_t initialWindow = DEFAULT_INITIAL_WINDOW, uint32_t highWater = DEFAULT_HIGH_WATER) :
+        minWindow_(minWindow), maxWindow_(maxWindow), highWater_(highWater), haveSnapshot_(false) {
+        for (uint8_t i = 0; i < Application::APPLICATION_COUNT; ++i) {
+            window_[i] = initialWindow;
+            credits_[i] = initialWindow;
+            exhausted_[i] = false;
+        }
+    }
+
+    // Take a credit before sending a message to appId; false means wait for the next heartbeat
+    bool acquire(uint8_t appId) {
+        if (!haveSnapshot_ || appId >= Application::APPLICATION_COUNT) return true;
+        if (credits_[appId] == 0) {
+            exhausted_[appId] = true;
+            return false;
+        }
+        if (--credits_[appId] == 0) exhausted_[appId] = true;
+        return true;
+    }
+
+    void heartbeat(const LinkCountersSnapshot &s) {
+        // The target counts every event since it started, so only differences between heartbeats are
+        // meaningful; the first heartbeat only sets the reference
+        bool congested = haveSnapshot_ &&
+            (s.allocationFailures_ != last_.allocationFailures_ ||
+             (s.postedCapacity_ != 0 && (uint32_t)s.postedDepth_ * 100 > (uint32_t)s.postedCapacity_ * highWater_));
+        for (uint8_t i = 0; i < Application::APPLICATION_COUNT; ++i) {
+            bool dropped = haveSnapshot_ && s.dropped_[i] != last_.dropped_[i];
+            if (congested || dropped) {
+                window_[i] = window_[i] / 2 > minWindow_ ? window_[i] / 2 : minWindow_;
+            } else if (exhausted_[i] && window_[i] < maxWindow_) {
+                ++window_[i];
+            }
+            credits_[i] = window_[i];
+            exhausted_[i] = false;
+        }
+        last_ = s;
+        haveSnapshot_ = true;
+    }
+
+    // False until the first heartbeat, while acquire() lets everything through
+    bool throttling() const { return haveSnapshot_; }
+
+    uint32_t window(uint8_t appId) const { return window_[appId]; }
+    uint32_t credits(uint8_t appId) const { return credits_[appId]; }
+
+private:
+    uint32_t minWindow_;
+    uint32_t maxWindow_;
+    uint32_t highWater_;
+    uint32_t window_[Application::APPLICATION_COUNT];
+    uint32_t credits_[Application::APPLICATION_COUNT];
+    bool exhausted_[Application::APPLICATION_COUNT];
+    LinkCountersSnapshot last_;
+    bool haveSnapshot_;
+};
+
+}}
+
+#endif
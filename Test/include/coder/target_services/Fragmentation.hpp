@@ -0,0 +1,234 @@
+// Fragmentation.hpp : fragmentation and reassembly of large payloads
+
+#ifndef coder_tgtsvc_Fragmentation_hpp
+#define coder_tgtsvc_Fragmentation_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include "Application.hpp"
+#include "Message.hpp"
+#include "LinkCounters.hpp"
+
+#ifndef CODER_TGTSVC_MAX_JUMBO_SIZE
+#define CODER_TGTSVC_MAX_JUMBO_SIZE (64u*1024u)
+#endif
+
+namespace coder { namespace tgtsvc {
+
+// Buffers larger than one message travel as a run of fragments, each a message of the sending application
+// whose payload starts with a FragmentHeader. Fragments of a stream are sent in order and carry their offset,
+// so the receiver copies each one straight to its place in a single buffer of the announced total size.
+struct FragmentHeader
+{
+    uint16_t streamId_;
+    uint16_t reserved_;
+    uint32_t totalSize_;
+    uint32_t offset_;
+};
+
+// Splits one buffer at a time into fragments. send() emits as many fragments as the transport accepts and
+// can be called again to resume; the buffer must stay valid until done(). maxPayload is the largest message
+// payload the link takes, usually the negotiated ConnectResponseMsg::maxPayload_ or Message::maxPayloadCapacity();
+// it is clamped to what the message pools can hold.
+class FragmentSender
+{
+public:
+    FragmentSender(uint8_t appId, uint8_t appFun, uint16_t maxPayload) :
+        appId_(appId), appFun_(appFun), maxData_(dataCapacity(maxPayload)),
+        data_(NULL), size_(0), offset_(0), streamId_(0), started_(false) {
+        assert(maxData_ != 0);
+    }
+
+    void start(uint16_t streamId, const uint8_t *data, uint32_t size) {
+        assert(done());
+        streamId_ = streamId;
+        data_ = data;
+        size_ = size;
+        offset_ = 0;
+        started_ = true;
+    }
+
+    bool done() const { return !started_; }
+
+    // sendFcn(Message*) returns TSE_SUCCESS when it has taken the message
+    template <typename SendFcn>
+    TSEStatus send(SendFcn sendFcn) {
+        while (started_) {
+            uint32_t n = size_ - offset_ < maxData_ ? size_ - offset_ : maxData_;
+            Message *m = Message::alloc((uint16_t)(sizeof(FragmentHeader) + n));
+            if (m == NULL) return TSE_RESOURCE_UNAVAILABLE;
+            m->payloadSize((uint16_t)(sizeof(FragmentHeader) + n));
+            m->appId(appId_);
+            m->appFun(appFun_);
+
+            FragmentHeader h;
+            h.streamId_ = streamId_;
+            h.reserved_ = 0;
+            h.totalSize_ = size_;
+            h.offset_ = offset_;
+            memcpy(m->payload(), &h, sizeof(h));
+            if (n != 0) memcpy(m->payload() + sizeof(h), data_ + offset_, n);
+
+            TSEStatus s = sendFcn(m);
+            if (s != TSE_SUCCESS) {
+                delete m;
+                return s;
+            }
+            offset_ += n;
+            if (offset_ == size_) started_ = false;
+        }
+        return TSE_SUCCESS;
+    }
+
+private:
+    uint8_t appId_;
+    uint8_t appFun_;
+    uint16_t maxData_;
+    const uint8_t *data_;
+    uint32_t size_;
+    uint32_t offset_;
+    uint16_t streamId_;
+    bool started_;
+
+    static uint16_t dataCapacity(uint16_t maxPayload) {
+        uint16_t limit = Message::maxPayloadCapacity();
+        if (maxPayload > limit) maxPayload = limit;
+        return maxPayload > sizeof(FragmentHeader) ? (uint16_t)(maxPayload - sizeof(FragmentHeader)) : 0;
+    }
+
+    FragmentSender(const FragmentSender &);
+    FragmentSender &operator=(const FragmentSender &);
+};
+
+// Receives fragments for up to MAX_STREAMS concurrent streams of up to maxSize bytes each. The buffers are
+// reserved once, when the reassembler is made, so receiving takes no memory beyond them.
+//
+// Fragments are expected in order, as the comm service links deliver them, and a stream is not repaired: a
+// fragment other than the next one expected discards the whole stream, as does a stream left idle for longer
+// than the timeout or restarted before it completed. dropped() counts these streams and errors() the fragments
+// that were malformed or belonged to no stream; the sender has to send a dropped buffer again.
+template<size_t MAX_STREAMS = 4>
+class Reassembler
+{
+public:
+    explicit Reassembler(uint32_t timeoutMs, uint32_t maxSize = CODER_TGTSVC_MAX_JUMBO_SIZE) :
+        timeoutMs_(timeoutMs), maxSize_(maxSize), errors_(0), dropped_(0) {
+        assert(maxSize <= CODER_TGTSVC_MAX_JUMBO_SIZE);
+        arena_ = static_cast<uint8_t*>(malloc((size_t)MAX_STREAMS * (maxSize ? maxSize : 1)));
+        if (arena_ == NULL) maxSize_ = 0;
+        for (size_t i = 0; i < MAX_STREAMS; ++i) streams_[i].buffer_ = arena_ + i * maxSize_;
+    }
+
+    ~Reassembler() { ::free(arena_); }
+
+    // Consumes the message. handler(streamId, data, size) is called with the complete buffer once the last
+    // fragment of a stream has arrived; data is only valid during the call, which must not call receive().
+    template <typename Handler>
+    TSEStatus receive(Message *message, uint32_t now, Handler handler) {
+        std::unique_ptr<Message> owner(message);
+        FragmentHeader h;
+        if (message->payloadSize() < sizeof(h)) return fail();
+        memcpy(&h, message->payload(), sizeof(h));
+        const uint8_t *data = message->payload() + sizeof(h);
+        uint32_t n = message->payloadSize() - (uint32_t)sizeof(h);
+
+        Stream *s = find(message->appId(), h.streamId_);
+        if (h.offset_ == 0) {
+            if (s != NULL) {
+                // A new buffer before the previous one completed
+                drop(*s);
+            }
+            if (n > h.totalSize_) return fail();
+            if (h.totalSize_ > maxSize_) return TSE_RESOURCE_UNAVAILABLE;
+            s = vacant();
+            if (s == NULL) return TSE_RESOURCE_UNAVAILABLE;
+            s->active_ = true;
+            s->appId_ = message->appId();
+            s->streamId_ = h.streamId_;
+            s->totalSize_ = h.totalSize_;
+            s->received_ = 0;
+        } else if (s == NULL) {
+            return fail();
+        } else if (h.offset_ != s->received_ || h.totalSize_ != s->totalSize_ || n > s->totalSize_ - h.offset_) {
+            drop(*s);
+            return TSE_ERROR;
+        }
+
+        memcpy(s->buffer_ + s->received_, data, n);
+        s->received_ += n;
+        s->lastActivity_ = now;
+        if (s->received_ == s->totalSize_) {
+            handler(s->streamId_, (const uint8_t *)s->buffer_, s->totalSize_);
+            s->active_ = false;
+        }
+        return TSE_SUCCESS;
+    }
+
+    // Drop the streams that have not progressed for timeoutMs
+    void expire(uint32_t now) {
+        for (size_t i = 0; i < MAX_STREAMS; ++i) {
+            Stream &s = streams_[i];
+            if (s.active_ && (uint32_t)(now - s.lastActivity_) > timeoutMs_) drop(s);
+        }
+    }
+
+    uint32_t errors() const { return errors_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    struct Stream {
+        Stream() : buffer_(NULL), active_(false), appId_(0), streamId_(0), totalSize_(0), received_(0),
+            lastActivity_(0) {}
+
+        uint8_t *buffer_;
+        bool active_;
+        uint8_t appId_;
+        uint16_t streamId_;
+        uint32_t totalSize_;
+        uint32_t received_;
+        uint32_t lastActivity_;
+    };
+
+    Stream streams_[MAX_STREAMS];
+    uint8_t *arena_;
+    uint32_t timeoutMs_;
+    uint32_t maxSize_;
+    uint32_t errors_;
+    uint32_t dropped_;
+
+    TSEStatus fail() {
+        ++errors_;
+        return TSE_ERROR;
+    }
+
+    void drop(Stream &s) {
+        s.active_ = false;
+        ++dropped_;
+        LinkCounters::instance().dropped(s.appId_);
+    }
+
+    Stream *find(uint8_t appId, uint16_t streamId) {
+        for (size_t i = 0; i < MAX_STREAMS; ++i) {
+            Stream &s = streams_[i];
+            if (s.active_ && s.appId_ == appId && s.streamId_ == streamId) return &s;
+        }
+        return NULL;
+    }
+
+    Stream *vacant() {
+        for (size_t i = 0; i < MAX_STREAMS; ++i) {
+            if (!streams_[i].active_) return &streams_[i];
+        }
+        return NULL;
+    }
+
+    Reassembler(const Reassembler &);
+    Reassembler &operator=(const Reassembler &);
+};
+
+}}
+
+#endif
@@ -0,0 +1,289 @@
+// LinkBenchmark.hpp : throughput and latency benchmark for a transport
+
+#ifndef coder_tgtsvc_LinkBenchmark_hpp
+#define coder_tgtsvc_LinkBenchmark_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Message.hpp"
+#include "MessageAssembler.hpp"
+#include "CommServiceBase.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Host side driver for the link tests built into CommServiceBase. For each message size it measures
+//  - IN_TEST:  the target streams count TestDataMsg to the host, ending with TestConcludedMsg
+//  - OUT_TEST: the host streams count TestDataMsg to the target and waits for OutTestResultMsg
+//  - RTT:      single-message OUT_TEST exchanges, timed one by one
+// The transport moves raw bytes and provides
+//     bool write(const uint8_t *data, size_t size);                      // all bytes or failure
+//     size_t read(uint8_t *data, size_t size, uint32_t timeoutMs);       // 0 on timeout or error
+struct LinkBenchmarkResult
+{
+    uint16_t size_;
+    uint32_t count_;
+    bool passed_;
+    double inMessagesPerSec_;
+    double inMBytesPerSec_;
+    double outMessagesPerSec_;
+    double outMBytesPerSec_;
+    double rttP50Us_;
+    double rttP90Us_;
+    double rttP99Us_;
+    double rttMaxUs_;
+};
+
+template <class Transport>
+class LinkBenchmark
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit LinkBenchmark(Transport &transport, uint32_t timeoutMs = 5000) :
+        transport_(transport), timeoutMs_(timeoutMs), payload_(0xFFFF) {}
+
+    LinkBenchmarkResult run(uint16_t size, uint32_t count, uint32_t rttSamples) {
+        LinkBenchmarkResult r;
+        memset(&r, 0, sizeof(r));
+        r.size_ = size;
+        r.count_ = count;
+        r.passed_ = true;
+
+        double seconds;
+        if (inTest(size, count, seconds)) {
+            rates(size, count, seconds, r.inMessagesPerSec_, r.inMBytesPerSec_);
+        } else {
+            r.passed_ = false;
+        }
+
+        if (outTest(size, count, seconds)) {
+            rates(size, count, seconds, r.outMessagesPerSec_, r.outMBytesPerSec_);
+        } else {
+            r.passed_ = false;
+        }
+
+        std::vector<double> rtt;
+        rtt.reserve(rttSamples);
+        for (uint32_t i = 0; i < rttSamples; ++i) {
+            if (!outTest(size, 1, seconds)) {
+                r.passed_ = false;
+                break;
+            }
+            rtt.push_back(seconds * 1e6);
+        }
+        if (!rtt.empty()) {
+            std::sort(rtt.begin(), rtt.end());
+            r.rttP50Us_ = percentile(rtt, 50);
+            r.rttP90Us_ = percentile(rtt, 90);
+            r.rttP99Us_ = percentile(rtt, 99);
+            r.rttMaxUs_ = rtt.back();
+        }
+        return r;
+    }
+
+    // Sizes double from ABSOLUTE_MINIMUM_PAYLOAD and end with ABSOLUTE_MAXIMUM_PAYLOAD
+    void sweep(uint32_t count, uint32_t rttSamples, std::vector<LinkBenchmarkResult> &results) {
+        for (uint32_t size = Message::ABSOLUTE_MINIMUM_PAYLOAD; ; size *= 2) {
+            if (size > Message::ABSOLUTE_MAXIMUM_PAYLOAD) size = Message::ABSOLUTE_MAXIMUM_PAYLOAD;
+            results.push_back(run((uint16_t)size, count, rttSamples));
+            if (size == Message::ABSOLUTE_MAXIMUM_PAYLOAD) break;
+        }
+    }
+
+    static void print(FILE *out, const std::vector<LinkBenchmarkResult> &results) {
+        fprintf(out, "%6s %8s %12s %10s %12s %10s %10s %10s %10s %10s %s\n", "size", "count",
+                "in msg/s", "in MB/s", "out msg/s", "out MB/s", "rtt p50us", "rtt p90us", "rtt p99us", "rtt max", "");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const LinkBenchmarkResult &r = results[i];
+            fprintf(out, "%6u %8u %12.0f %10.2f %12.0f %10.2f %10.1f %10.1f %10.1f %10.1f %s\n", r.size_, r.count_,
+                    r.inMessagesPerSec_, r.inMBytesPerSec_, r.outMessagesPerSec_, r.outMBytesPerSec_,
+                    r.rttP50Us_, r.rttP90Us_, r.rttP99Us_, r.rttMaxUs_, r.passed_ ? "" : "FAILED");
+        }
+    }
+
+private:
+    Transport &transport_;
+    uint32_t timeoutMs_;
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> out_;
+
+    bool inTest(uint16_t size, uint32_t count, double &seconds) {
+        out_.clear();
+        appendStart(IN_TEST_START_MSG_ID, size, count);
+        Clock::time_point start = Clock::now();
+        if (!transport_.write(&out_[0], out_.size())) return false;
+
+        uint32_t received = 0;
+        for (;;) {
+            MessageHeader h;
+            if (!readMessage(h)) return false;
+            if (h.appId_ != COMM_SERVICE_ID) continue;
+            if (h.appFun_ == TestDataMsg::ID) {
+                if (h.payloadSize_ == size) ++received;
+            } else if (h.appFun_ == TestConcludedMsg::ID) {
+                break;
+            }
+        }
+        seconds = elapsed(start);
+        return received == count;
+    }
+
+    bool outTest(uint16_t size, uint32_t count, double &seconds) {
+        out_.clear();
+        appendStart(OUT_TEST_START_MSG_ID, size, count);
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < count; ++i) {
+            appendHeader(TestDataMsg::ID, size);
+            out_.resize(out_.size() + size);
+            if (out_.size() >= 64*1024) {
+                if (!transport_.write(&out_[0], out_.size())) return false;
+                out_.clear();
+            }
+        }
+        appendHeader(TestConcludedMsg::ID, TestConcludedMsg::PAYLOAD_SIZE);
+        out_.resize(out_.size() + TestConcludedMsg::PAYLOAD_SIZE);
+        if (!transport_.write(&out_[0], out_.size())) return false;
+
+        for (;;) {
+            MessageHeader h;
+            if (!readMessage(h)) return false;
+            if (h.appId_ == COMM_SERVICE_ID && h.appFun_ == OutTestResultMsg::ID) {
+                seconds = elapsed(start);
+                return h.payloadSize_ >= OutTestResultMsg::PAYLOAD_SIZE &&
+                    payload_[0] == OutTestResultMsg::RESULT_OK;
+            }
+        }
+    }
+
+    // The start messages carry testMsgCount_ then testMsgSize_, in target byte order
+    void appendStart(uint8_t fun, uint16_t size, uint32_t count) {
+        appendHeader(fun, InTestStartMsg::PAYLOAD_SIZE);
+        size_t at = out_.size();
+        out_.resize(at + InTestStartMsg::PAYLOAD_SIZE);
+        memcpy(&out_[at], &count, sizeof(count));
+        memcpy(&out_[at + sizeof(count)], &size, sizeof(size));
+    }
+
+    void appendHeader(uint8_t fun, uint16_t payloadSize) {
+        MessageHeader h;
+        h.payloadSize_ = payloadSize;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = fun;
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(&h);
+        out_.insert(out_.end(), p, p + sizeof(h));
+    }
+
+    bool readMessage(MessageHeader &h) {
+        return readExactly(reinterpret_cast<uint8_t*>(&h), sizeof(h)) &&
+            readExactly(&payload_[0], h.payloadSize_);
+    }
+
+    bool readExactly(uint8_t *p, size_t size) {
+        while (size != 0) {
+            size_t n = transport_.read(p, size, timeoutMs_);
+            if (n == 0) return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static double elapsed(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    static void rates(uint16_t size, uint32_t count, double seconds, double &msgs, double &mbytes) {
+        if (seconds <= 0) return;
+        msgs = count / seconds;
+        mbytes = msgs * (size + sizeof(MessageHeader)) / (1024.0 * 1024.0);
+    }
+
+    // Nearest rank on sorted samples
+    static double percentile(const std::vector<double> &sorted, unsigned p) {
+        size_t rank = (sorted.size() * p + 99) / 100;
+        return sorted[rank == 0 ? 0 : rank - 1];
+    }
+
+    LinkBenchmark(const LinkBenchmark &);
+    LinkBenchmark &operator=(const LinkBenchmark &);
+};
+
+// Target side of the link tests over a byte stream: CommServiceBase fed by feed() and emitting the bytes of
+// every message it sends into an output buffer. A socket server can wrap it to benchmark a real link.
+class LinkTestTarget : public CommServiceBase<LinkTestTarget>
+{
+public:
+    LinkTestTarget() {}
+
+    TSEStatus sendMessage(Message *message, Message::Priority) {
+        output_.insert(output_.end(), message->transmitStart(), message->transmitStart() + message->transmitSize());
+        delete message;
+        return TSE_SUCCESS;
+    }
+
+    // Handle every complete message in the input; other applications' messages go to Application::dispatch
+    void feed(const uint8_t *data, size_t size) {
+        const uint8_t *it = data;
+        assembler_.assembleAll(it, data + size, Handler(*this));
+    }
+
+    // Move pending output into out; returns false when there is none
+    bool drain(std::vector<uint8_t> &out) {
+        if (output_.empty()) return false;
+        out.insert(out.end(), output_.begin(), output_.end());
+        output_.clear();
+        return true;
+    }
+
+private:
+    MessageAssembler assembler_;
+    std::vector<uint8_t> output_;
+
+    struct Handler {
+        explicit Handler(LinkTestTarget &target) : target_(target) {}
+        void operator()(std::unique_ptr<Message> message) {
+            if (message->appId() == COMM_SERVICE_ID) target_.handleCSMessage(message.release());
+            else Application::dispatch(message.release());
+        }
+        LinkTestTarget &target_;
+    };
+};
+
+// In-process transport: reading runs the target until it has produced output
+class LoopbackTransport
+{
+public:
+    explicit LoopbackTransport(LinkTestTarget &target) : target_(target), readPos_(0) {}
+
+    bool write(const uint8_t *data, size_t size) {
+        target_.feed(data, size);
+        return true;
+    }
+
+    size_t read(uint8_t *data, size_t size, uint32_t) {
+        while (readPos_ == input_.size()) {
+            input_.clear();
+            readPos_ = 0;
+            target_();
+            if (!target_.drain(input_)) return 0;
+        }
+        size_t n = std::min(size, input_.size() - readPos_);
+        memcpy(data, &input_[readPos_], n);
+        readPos_ += n;
+        return n;
+    }
+
+private:
+    LinkTestTarget &target_;
+    std::vector<uint8_t> input_;
+    size_t readPos_;
+};
+
+}}
+
+#endif
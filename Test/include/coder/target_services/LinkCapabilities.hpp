@@ -0,0 +1,119 @@
+// LinkCapabilities.hpp : optional link features agreed with CapabilitiesMsg
+
+#ifndef coder_tgtsvc_LinkCapabilities_hpp
+#define coder_tgtsvc_LinkCapabilities_hpp
+
+#include <stdint.h>
+#include <atomic>
+
+namespace coder { namespace tgtsvc {
+
+// Target side: what the comm service agreed to in its last CapabilitiesResponseMsg. The receive thread records
+// the agreement and the senders that depend on it read it from any thread. The whole agreement is kept in one
+// word, so a reader never sees half of a renegotiation.
+class LinkCapabilities
+{
+public:
+    struct Agreement {
+        uint32_t capabilities_;
+        uint32_t compressedApps_;
+        uint16_t compressionThreshold_;
+    };
+
+    // Only the low 16 bits of capabilities are kept
+    void agree(uint32_t capabilities, uint32_t compressedApps, uint16_t compressionThreshold) {
+        word_.store((uint64_t)(capabilities & 0xFFFF) | ((uint64_t)compressionThreshold << 16) |
+                    ((uint64_t)compressedApps << 32), std::memory_order_release);
+    }
+
+    // Nothing is agreed on a new connection until it is negotiated again
+    void reset() { word_.store(0, std::memory_order_release); }
+
+    Agreement agreement() const {
+        uint64_t w = word_.load(std::memory_order_acquire);
+        Agreement a;
+        a.capabilities_ = (uint32_t)(w & 0xFFFF);
+        a.compressionThreshold_ = (uint16_t)(w >> 16);
+        a.compressedApps_ = (uint32_t)(w >> 32);
+        return a;
+    }
+
+    bool agreed(uint32_t capability) const {
+        return (word_.load(std::memory_order_acquire) & capability & 0xFFFF) != 0;
+    }
+
+    static LinkCapabilities &instance() {
+        static LinkCapabilities capabilities;
+        return capabilities;
+    }
+
+private:
+    std::atomic<uint64_t> word_;
+
+    LinkCapabilities() { word_.store(0, std::memory_order_relaxed); }
+
+    LinkCapabilities(const LinkCapabilities &);
+    LinkCapabilities &operator=(const LinkCapabilities &);
+};
+
+// Host side. Targets built before CapabilitiesMsg existed do not answer it; they only set the sticky
+// UNRECOGNIZED_MSG status flag. A request left unanswered for the timeout is therefore taken as refused, and the
+// host carries on with none of the capabilities. Time is a free-running millisecond count supplied by the caller.
+class CapabilityNegotiator
+{
+public:
+    enum {
+        DEFAULT_TIMEOUT_MS = 1000
+    };
+
+    explicit CapabilityNegotiator(uint32_t timeoutMs = DEFAULT_TIMEOUT_MS) :
+        timeoutMs_(timeoutMs), requested_(0), agreed_(0), sentMs_(0), pending_(false), timedOut_(false) {}
+
+    // Call once the CapabilitiesMsg asking for capabilities has been sent
+    void requested(uint32_t capabilities, uint32_t nowMs) {
+        requested_ = capabilities;
+        agreed_ = 0;
+        sentMs_ = nowMs;
+        pending_ = true;
+        timedOut_ = false;
+    }
+
+    // Call with CapabilitiesResponseMsg::capabilities_; a late response after a timeout is ignored
+    void responded(uint32_t capabilities) {
+        if (!pending_) return;
+        agreed_ = capabilities & requested_;
+        pending_ = false;
+    }
+
+    // Returns true while the request is still waiting for an answer
+    bool poll(uint32_t nowMs) {
+        if (pending_ && (uint32_t)(nowMs - sentMs_) >= timeoutMs_) {
+            pending_ = false;
+            timedOut_ = true;
+        }
+        return pending_;
+    }
+
+    // Forget the agreement, as the target does on ConnectMsg
+    void reset() {
+        agreed_ = 0;
+        pending_ = false;
+        timedOut_ = false;
+    }
+
+    bool pending() const { return pending_; }
+    bool timedOut() const { return timedOut_; }
+    uint32_t agreed() const { return agreed_; }
+
+private:
+    uint32_t timeoutMs_;
+    uint32_t requested_;
+    uint32_t agreed_;
+    uint32_t sentMs_;
+    bool pending_;
+    bool timedOut_;
+};
+
+}}
+
+#endif
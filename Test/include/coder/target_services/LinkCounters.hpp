@@ -0,0 +1,98 @@
+// LinkCounters.hpp : per-application link counters
+
+#ifndef coder_tgtsvc_LinkCounters_hpp
+#define coder_tgtsvc_LinkCounters_hpp
+
+#include <stdint.h>
+#include "Atomic.hpp"
+#include "Application.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Link counters carried by HeartbeatExResponseMsg. Unlike StatusFlags they are never cleared, so the host
+// computes rates from the difference between two heartbeats.
+struct LinkCountersSnapshot
+{
+    uint32_t statusFlags_;
+    uint32_t allocationFailures_;
+    uint16_t postedDepth_;
+    uint16_t postedCapacity_;
+    uint32_t sent_[Application::APPLICATION_COUNT];
+    uint32_t received_[Application::APPLICATION_COUNT];
+    uint32_t sendFailures_[Application::APPLICATION_COUNT];
+    uint32_t dropped_[Application::APPLICATION_COUNT];
+};
+
+// Counters may be bumped from any thread. Each is kept by the target services code that sees the event:
+// - sent and send failures by MessageOutbox, for the messages posted through it;
+// - received by ApplicationDispatcher, for the messages dispatched through it;
+// - dropped by the components that discard an application's messages or data: the outbox when it is destroyed
+//   with messages still queued, ToAsyncQueueBatcher, Reassembler and the expansion of CompressedMsg.
+// Traffic that bypasses these, such as the dispatch loop of the prebuilt comm services, is not counted.
+class LinkCounters
+{
+public:
+    void sent(uint8_t appId) { bump(sent_, appId); }
+    void received(uint8_t appId) { bump(received_, appId); }
+    void sendFailed(uint8_t appId) { bump(sendFailures_, appId); }
+    void dropped(uint8_t appId) { bump(dropped_, appId); }
+    void allocationFailed() { ++allocationFailures_; }
+
+    // Messages waiting in MessageOutbox queues, and the room they have
+    void queued() { ++postedDepth_; }
+    void dequeued() { --postedDepth_; }
+    void queueAdded(uint32_t capacity) { postedCapacity_ += capacity; }
+    void queueRemoved(uint32_t capacity) { postedCapacity_ -= capacity; }
+
+    void snapshot(LinkCountersSnapshot &s) const {
+        s.allocationFailures_ = allocationFailures_;
+        s.postedDepth_ = (uint16_t)postedDepth_;
+        s.postedCapacity_ = (uint16_t)postedCapacity_;
+        for (uint8_t i = 0; i < Application::APPLICATION_COUNT; ++i) {
+            s.sent_[i] = sent_[i];
+            s.received_[i] = received_[i];
+            s.sendFailures_[i] = sendFailures_[i];
+            s.dropped_[i] = dropped_[i];
+        }
+    }
+
+    static LinkCounters &instance() {
+        static LinkCounters counters;
+        return counters;
+    }
+
+private:
+    typedef Atomic<uint32_t>::type Counter;
+
+    Counter sent_[Application::APPLICATION_COUNT];
+    Counter received_[Application::APPLICATION_COUNT];
+    Counter sendFailures_[Application::APPLICATION_COUNT];
+    Counter dropped_[Application::APPLICATION_COUNT];
+    Counter allocationFailures_;
+    Counter postedDepth_;
+    Counter postedCapacity_;
+
+    LinkCounters() {
+        allocationFailures_ = 0;
+        postedDepth_ = 0;
+        postedCapacity_ = 0;
+        for (uint8_t i = 0; i < Application::APPLICATION_COUNT; ++i) {
+            sent_[i] = 0;
+            received_[i] = 0;
+            sendFailures_[i] = 0;
+            dropped_[i] = 0;
+        }
+    }
+
+    // Messages of the comm service itself are not counted
+    static void bump(Counter *counters, uint8_t appId) {
+        if (appId < Application::APPLICATION_COUNT) ++counters[appId];
+    }
+
+    LinkCounters(const LinkCounters &);
+    LinkCounters &operator=(const LinkCounters &);
+};
+
+}}
+
+#endif
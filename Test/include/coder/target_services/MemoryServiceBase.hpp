@@ -8,6 +8,7 @@
 #include "coder_target_services_spec.h"
 #include "SList.hpp"
 #include "StatusFlags.hpp"
+#include "LinkCounters.hpp"
 
 namespace coder { namespace tgtsvc {
    
@@ -71,7 +72,7 @@ public:
 
     void *alloc(size_t request) throw() {
 
-        uint8_t poolIdx = whichPool(request);
+        uint8_t poolIdx = static_cast<Derived*>(this)->whichPool(request);
         detail::Chunk  *c = NULL;
         if (poolIdx < poolCount()) {
 
@@ -87,6 +88,7 @@ public:
             c->allocated(true);
         } else {
             StatusFlags::instance().set(StatusFlags::MEMORY_ALLOCATION_FAILED);
+            LinkCounters::instance().allocationFailed();
         }
         return c;
     }
@@ -107,16 +109,19 @@ public:
 
     uint16_t maxCapacity() const { return poolSize(poolCount()-1); }
 
-private:
-    const uint16_t *poolSizes_;
-    uint8_t poolCount_;
-
+protected:
+    // Index of the smallest pool that fits requestSize, or poolCount() if none does; a derived service may
+    // hide it with a faster lookup
     uint8_t whichPool(size_t requestSize) {
         uint8_t r = 0;
         while (r < poolCount() && poolSize(r) < requestSize) ++r;
         return r;
     }
 
+private:
+    const uint16_t *poolSizes_;
+    uint8_t poolCount_;
+
 	MemoryServiceBase(const MemoryServiceBase &cpy);
 
 	MemoryServiceBase &operator=(const MemoryServiceBase &cpy);
@@ -4,9 +4,14 @@
 #define coder_tgtsvc_MessageAssembler_hpp
 
 #include <memory>
+#include <string.h>
 
 namespace coder { namespace tgtsvc {
 
+namespace detail {
+template<typename T, size_t N> class fifo;
+}
+
 struct MessageAssembler
 {
     enum Return {
@@ -44,6 +49,68 @@ struct MessageAssembler
         return INCOMPLETE;
     }
 
+    // Contiguous input: the header and the payload are copied in whole runs rather than byte by byte.
+    Return assemble(const uint8_t *&it, const uint8_t *end) {
+        while (it != end) {
+
+            if (pos_ < sizeof(MessageHeader)) {
+                size_t n = run(it, end, sizeof(MessageHeader));
+                memcpy(headerAddr() + pos_, it, n);
+                it += n;
+                pos_ += n;
+                if (pos_ < sizeof(MessageHeader)) break;
+            }
+
+            if (!msg_) {
+                msg_.reset(Message::alloc(hdr_.payloadSize()));
+                if (!msg_) return NO_RESOURCES;
+                msg_->header(hdr_);
+            }
+
+            size_t n = run(it, end, msg_->transmitSize());
+            memcpy(msg_->transmitStart() + pos_, it, n);
+            it += n;
+            pos_ += n;
+
+            if (pos_ == msg_->transmitSize()) {
+                pos_ = 0;
+                return SUCCESS;
+            }
+        }
+        return INCOMPLETE;
+    }
+
+    Return assemble(uint8_t *&it, uint8_t *end) {
+        const uint8_t *cit = it;
+        Return r = assemble(cit, const_cast<const uint8_t*>(end));
+        it += cit - it;
+        return r;
+    }
+
+    // Assemble every complete message in [it, end), handing each to handler as a std::unique_ptr<Message>.
+    // Returns INCOMPLETE once the input is used up, or NO_RESOURCES with it left at the unconsumed input.
+    template <typename Handler>
+    Return assembleAll(const uint8_t *&it, const uint8_t *end, Handler handler) {
+        for (;;) {
+            Return r = assemble(it, end);
+            if (r != SUCCESS) return r;
+            handler(message());
+        }
+    }
+
+    // Same, draining the contiguous segments of a receive fifo in place.
+    template <size_t N, typename Handler>
+    Return assembleAll(detail::fifo<uint8_t, N> &rx, Handler handler) {
+        for (;;) {
+            typename detail::fifo<uint8_t, N>::carray segment = rx.contents_carray();
+            if (segment.size_ == 0) return INCOMPLETE;
+            const uint8_t *it = segment.addr_;
+            Return r = assembleAll(it, it + segment.size_, handler);
+            rx.contents_remove(it - segment.addr_);
+            if (r == NO_RESOURCES) return r;
+        }
+    }
+
     std::unique_ptr<Message> message() { return std::move(msg_); }
 
     void reset() {
@@ -57,6 +124,11 @@ private:
     MessageHeader hdr_;           
 
     uint8_t *headerAddr() { return reinterpret_cast<uint8_t*>(&hdr_); }
+
+    size_t run(const uint8_t *it, const uint8_t *end, size_t limit) const {
+        size_t avail = end - it;
+        return avail < limit - pos_ ? avail : limit - pos_;
+    }
 };
 
 }}
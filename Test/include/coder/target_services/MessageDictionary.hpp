@@ -1,7 +1,11 @@
 /* Copyright 2013 MathWorks, Inc. */
 
+#ifndef coder_tgtsvc_MessageDictionary_hpp
+#define coder_tgtsvc_MessageDictionary_hpp
+
 #include <coder/target_services/Message.hpp>
 #include <coder/target_services/StatusFlags.hpp>
+#include <coder/target_services/LinkCounters.hpp>
 
 namespace coder { namespace tgtsvc {
 
@@ -17,6 +21,11 @@ enum {
     OUT_TEST_START_MSG_ID     = 9,
     OUT_TEST_RESULT_MSG_ID    = 10,
     TEST_CONCLUDED_MSG_ID     = 11,
+    CAPABILITIES_MSG_ID       = 12,
+    CAPABILITIES_RESPONSE_MSG_ID = 13,
+    HEARTBEAT_EX_MSG_ID       = 14,
+    HEARTBEAT_EX_RESPONSE_MSG_ID = 15,
+    COMPRESSED_MSG_ID         = 16,
     COMM_SERVICE_ID = 0xFF
 };
 
@@ -121,6 +130,40 @@ public:
     coder::tgtsvc::StatusFlags statusFlags_;
 };
 
+class HeartbeatExMsg : public Message
+{
+public:
+    enum {
+        ID = HEARTBEAT_EX_MSG_ID,
+        PAYLOAD_SIZE = 0
+    };
+
+    HeartbeatExMsg() {
+        MessageHeader &h = header();
+        h.payloadSize_ = PAYLOAD_SIZE;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = ID;
+    }
+};
+
+class HeartbeatExResponseMsg : public Message
+{
+public:
+    enum {
+        ID = HEARTBEAT_EX_RESPONSE_MSG_ID,
+        PAYLOAD_SIZE = sizeof(coder::tgtsvc::LinkCountersSnapshot)
+    };
+
+    HeartbeatExResponseMsg() {
+        MessageHeader &h = header();
+        h.payloadSize_ = PAYLOAD_SIZE;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = ID;
+    }
+
+    coder::tgtsvc::LinkCountersSnapshot counters_;
+};
+
 class InTestStartMsg : public Message
 {
 public:
@@ -215,4 +258,78 @@ public:
     uint8_t pad_;
 };
 
+class CapabilitiesMsg : public Message
+{
+public:
+    enum {
+        ID = CAPABILITIES_MSG_ID,
+        PAYLOAD_SIZE = 2*sizeof(uint32_t) + sizeof(uint16_t)
+    };
+
+    enum {
+        CAP_COMPRESSION = 0x01,
+        CAP_BATCHING    = 0x02
+    };
+
+    CapabilitiesMsg() {
+        MessageHeader &h = header();
+        h.payloadSize_ = PAYLOAD_SIZE;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = ID;
+        capabilities_ = 0;
+        compressedApps_ = 0;
+        compressionThreshold_ = 0;
+    }
+
+    uint32_t capabilities_;
+    uint32_t compressedApps_;
+    uint16_t compressionThreshold_;
+};
+
+class CapabilitiesResponseMsg : public Message
+{
+public:
+    enum {
+        ID = CAPABILITIES_RESPONSE_MSG_ID,
+        PAYLOAD_SIZE = sizeof(uint32_t)
+    };
+
+    CapabilitiesResponseMsg() {
+        MessageHeader &h = header();
+        h.payloadSize_ = PAYLOAD_SIZE;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = ID;
+        capabilities_ = 0;
+    }
+
+    uint32_t capabilities_;
+};
+
+// Envelope of an application message whose payload was compressed (see PayloadCompressor.hpp). The original
+// application id, function and payload size come first, followed by the compressed payload.
+class CompressedMsg : public Message
+{
+public:
+    enum {
+        ID = COMPRESSED_MSG_ID,
+        HEADER_SIZE = 2*sizeof(uint8_t) + sizeof(uint16_t)
+    };
+
+    CompressedMsg() {
+        MessageHeader &h = header();
+        h.payloadSize_ = HEADER_SIZE;
+        h.appId_ = COMM_SERVICE_ID;
+        h.appFun_ = ID;
+    }
+
+    uint8_t *data() { return payload() + HEADER_SIZE; }
+    const uint8_t *data() const { return payload() + HEADER_SIZE; }
+
+    uint8_t originalAppId_;
+    uint8_t originalAppFun_;
+    uint16_t originalSize_;
+};
+
 }}
+
+#endif
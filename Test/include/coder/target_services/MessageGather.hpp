@@ -0,0 +1,108 @@
+// MessageGather.hpp : gathering of messages into one transport write
+
+#ifndef coder_tgtsvc_MessageGather_hpp
+#define coder_tgtsvc_MessageGather_hpp
+
+#include <stddef.h>
+#include <utility>
+#include "Message.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Gather list of messages waiting to be transmitted. Unlike Aggregator, the message bytes are not copied: the
+// transport is handed the transmitStart()/transmitSize() range of each message as a list of segments, reports
+// how many bytes it wrote, and every message that has been written completely is handed to the completion
+// function, which by default deletes it.
+template<size_t N>
+class MessageGather
+{
+public:
+	typedef std::pair<const uint8_t *, size_t> ArrayRange;
+	typedef void (*Completion)(Message *message, void *context);
+
+	explicit MessageGather(Completion completion = deleteMessage, void *context = NULL) :
+		in_(0), out_(0), offset_(0), bytes_(0), completion_(completion), context_(context) {}
+
+	~MessageGather() { clear(); }
+
+	bool empty() const { return (in_ == out_); }
+
+	bool full() const {
+		return (in_+1 == out_ || (out_ == 0 && in_ == N));
+	}
+
+	size_t count() const {
+		size_t r = in_ + N + 1 - out_;
+		return r<N+1 ? r : r-N-1;
+	}
+
+	// Number of bytes not yet transmitted
+	size_t bytes() const { return bytes_; }
+
+	bool put(Message *message) {
+		if (full()) return false;
+		messages_[in_] = message;
+		in_ = in_<N ? in_+1 : 0;
+		bytes_ += message->transmitSize();
+		return true;
+	}
+
+	// Fill segments with up to max ranges covering the bytes not yet transmitted, in order
+	size_t get(ArrayRange *segments, size_t max) const {
+		size_t n = 0;
+		size_t skip = offset_;
+		for (size_t i = out_; i != in_ && n < max; i = i<N ? i+1 : 0) {
+			const Message *m = messages_[i];
+			segments[n].first = m->transmitStart() + skip;
+			segments[n].second = m->transmitSize() - skip;
+			skip = 0;
+			++n;
+		}
+		return n;
+	}
+
+	// Account for count bytes written by the transport and complete the messages written in full
+	void release(size_t count) {
+		bytes_ -= count;
+		count += offset_;
+		while (!empty()) {
+			Message *m = messages_[out_];
+			size_t size = m->transmitSize();
+			if (count < size) break;
+			count -= size;
+			out_ = out_<N ? out_+1 : 0;
+			completion_(m, context_);
+		}
+		offset_ = count;
+	}
+
+	// Complete all messages, transmitted or not
+	void clear() {
+		while (!empty()) {
+			Message *m = messages_[out_];
+			out_ = out_<N ? out_+1 : 0;
+			completion_(m, context_);
+		}
+		in_ = out_ = 0;
+		offset_ = 0;
+		bytes_ = 0;
+	}
+
+	static void deleteMessage(Message *message, void *) { delete message; }
+
+private:
+	size_t in_;
+	size_t out_;
+	size_t offset_;
+	size_t bytes_;
+	Completion completion_;
+	void *context_;
+	Message *messages_[N+1];
+
+	MessageGather(const MessageGather &);
+	MessageGather &operator=(const MessageGather &);
+};
+
+}}
+
+#endif
@@ -0,0 +1,124 @@
+// MessageOutbox.hpp : messages posted by applications for the transport thread
+
+#ifndef coder_tgtsvc_MessageOutbox_hpp
+#define coder_tgtsvc_MessageOutbox_hpp
+
+#include <stddef.h>
+#include "Application.hpp"
+#include "Message.hpp"
+#include "MessageQueue.hpp"
+#include "LinkCounters.hpp"
+#include "PayloadCompressor.hpp"
+
+#ifndef CODER_TGTSVC_POSTED_QUEUE_SIZE
+#define CODER_TGTSVC_POSTED_QUEUE_SIZE 64
+#endif
+
+namespace coder { namespace tgtsvc {
+
+// Lets any number of application threads hand messages to a comm service without locking. The transport thread
+// calls send() in its loop, next to the service's operator(), and the messages reach Service::sendMessage there.
+// The queue lives here rather than in CommServiceBase so that the exported base keeps its layout. On the way out
+// the payloads of the applications negotiated with CapabilitiesMsg are compressed, and every message is counted
+// in LinkCounters as sent or refused; messages that bypass the outbox get neither.
+//
+// High priority messages are sent first. A message the transport does not accept is kept in its lane's slot and
+// retried first on the next send(), so the order within a lane is preserved and a refused normal priority
+// message never holds back a high priority one. It is counted as refused once, and its compressed copy is kept
+// for the retries.
+template<class Service, size_t N = CODER_TGTSVC_POSTED_QUEUE_SIZE>
+class MessageOutbox
+{
+public:
+
+    explicit MessageOutbox(Service &service) : service_(service) {
+        held_[Message::NORMAL_PRIORITY] = NULL;
+        held_[Message::HIGH_PRIORITY] = NULL;
+        wire_[Message::NORMAL_PRIORITY] = NULL;
+        wire_[Message::HIGH_PRIORITY] = NULL;
+        LinkCounters::instance().queueAdded((uint32_t)queue_.capacity());
+    }
+
+    // Messages still waiting are discarded
+    ~MessageOutbox() {
+        for (int lane = Message::NORMAL_PRIORITY; lane <= Message::HIGH_PRIORITY; ++lane) {
+            Message::Priority priority = static_cast<Message::Priority>(lane);
+            if (wire_[priority] != held_[priority]) delete wire_[priority];
+            wire_[priority] = NULL;
+            while (next(priority)) {
+                LinkCounters::instance().dropped(held_[priority]->appId());
+                delete held_[priority];
+                held_[priority] = NULL;
+                LinkCounters::instance().dequeued();
+            }
+        }
+        LinkCounters::instance().queueRemoved((uint32_t)queue_.capacity());
+    }
+
+    // Any thread. Takes the same arguments as Service::sendMessage so it can stand in for the service; on
+    // failure the caller still owns the message.
+    TSEStatus sendMessage(Message *message, Message::Priority priority=Message::NORMAL_PRIORITY) {
+        // Counted before the push so the transport thread never takes the depth below zero
+        LinkCounters::instance().queued();
+        if (!queue_.push(message, priority)) {
+            LinkCounters::instance().dequeued();
+            return TSE_RESOURCE_UNAVAILABLE;
+        }
+        return TSE_SUCCESS;
+    }
+
+    // Transport thread only
+    void send() {
+        for (;;) {
+            Message::Priority priority = Message::HIGH_PRIORITY;
+            if (!next(priority)) {
+                priority = Message::NORMAL_PRIORITY;
+                if (!next(priority)) break;
+            }
+            if (transmit(priority) != TSE_SUCCESS) break;
+            held_[priority] = NULL;
+            wire_[priority] = NULL;
+            LinkCounters::instance().dequeued();
+        }
+    }
+
+private:
+    Service &service_;
+    MessageQueue<N> queue_;
+    Message *held_[2];
+    Message *wire_[2];      // What the transport was offered for held_: held_ itself or its compressed copy
+    PayloadCompressor compressor_;
+
+    // The compressed copy of a refused message is reused by the retries unless the agreement has since dropped
+    // compression for its application
+    TSEStatus transmit(Message::Priority priority) {
+        Message *message = held_[priority];
+        uint8_t appId = message->appId();
+        bool retry = wire_[priority] != NULL;
+        if (retry && wire_[priority] != message && !compressor_.agreed(appId)) {
+            delete wire_[priority];
+            wire_[priority] = NULL;
+        }
+        if (wire_[priority] == NULL) wire_[priority] = compressor_.deflate(message);
+        TSEStatus s = service_.sendMessage(wire_[priority], priority);
+        if (s != TSE_SUCCESS) {
+            if (!retry) LinkCounters::instance().sendFailed(appId);
+            return s;
+        }
+        if (wire_[priority] != message) delete message;
+        LinkCounters::instance().sent(appId);
+        return s;
+    }
+
+    bool next(Message::Priority priority) {
+        if (held_[priority] == NULL) held_[priority] = queue_.pop(priority);
+        return held_[priority] != NULL;
+    }
+
+    MessageOutbox(const MessageOutbox &);
+    MessageOutbox &operator=(const MessageOutbox &);
+};
+
+}}
+
+#endif
@@ -0,0 +1,50 @@
+// MessageQueue.hpp : lock-free queue of posted messages
+
+#ifndef coder_tgtsvc_MessageQueue_hpp
+#define coder_tgtsvc_MessageQueue_hpp
+
+#include <stddef.h>
+#include "Message.hpp"
+#include "mpsc_fifo.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Messages posted by any number of application threads for the transport thread. HIGH_PRIORITY and
+// NORMAL_PRIORITY messages travel in separate lanes, and the transport thread pops each lane on its own.
+template<size_t N>
+class MessageQueue
+{
+public:
+
+    MessageQueue() {}
+
+    bool push(Message *message, Message::Priority priority) {
+        return lane(priority).push(message);
+    }
+
+    // Transport thread only.
+    bool empty() const {
+        return lanes_[Message::HIGH_PRIORITY].empty() && lanes_[Message::NORMAL_PRIORITY].empty();
+    }
+
+    static size_t capacity() { return 2*N; }
+
+    Message *pop(Message::Priority priority) {
+        Message *message = NULL;
+        return lane(priority).pop(message) ? message : NULL;
+    }
+
+private:
+    detail::mpsc_fifo<Message*, N> lanes_[2];
+
+    detail::mpsc_fifo<Message*, N> &lane(Message::Priority priority) {
+        return lanes_[priority == Message::HIGH_PRIORITY ? Message::HIGH_PRIORITY : Message::NORMAL_PRIORITY];
+    }
+
+    MessageQueue(const MessageQueue &);
+    MessageQueue &operator=(const MessageQueue &);
+};
+
+}}
+
+#endif
@@ -0,0 +1,276 @@
+// PayloadCompressor.hpp : negotiated payload compression
+
+#ifndef coder_tgtsvc_PayloadCompressor_hpp
+#define coder_tgtsvc_PayloadCompressor_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "Message.hpp"
+#include "MessageDictionary.hpp"
+#include "StatusFlags.hpp"
+#include "LinkCapabilities.hpp"
+#include "LinkCounters.hpp"
+
+namespace coder { namespace tgtsvc {
+
+namespace detail {
+
+// LZ77 block format of the LZ4 family: a token holds the literal count and the match length less four, each
+// extended by bytes of 255 when the nibble is 15, followed by the literals and a two byte offset. The last
+// sequence has literals only. Inputs are limited to 64 KiB, which fits every message payload.
+enum {
+    LZ_MIN_MATCH = 4,
+    LZ_HASH_BITS = 12,
+    LZ_LAST_LITERALS = 5,
+    LZ_MATCH_LIMIT = 12
+};
+
+inline uint32_t lz_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+inline uint8_t *lz_length(uint8_t *op, const uint8_t *oend, size_t len) {
+    while (len >= 255) {
+        if (op == oend) return NULL;
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op == oend) return NULL;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+inline uint8_t *lz_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *literals, size_t litLen,
+                            size_t offset, size_t matchLen) {
+    if (op == oend) return NULL;
+    uint8_t *token = op++;
+    *token = (uint8_t)((litLen < 15 ? litLen : 15) << 4);
+    if (litLen >= 15 && (op = lz_length(op, oend, litLen - 15)) == NULL) return NULL;
+    if ((size_t)(oend - op) < litLen) return NULL;
+    memcpy(op, literals, litLen);
+    op += litLen;
+    if (matchLen == 0) return op;
+
+    if (oend - op < 2) return NULL;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t m = matchLen - LZ_MIN_MATCH;
+    *token |= (uint8_t)(m < 15 ? m : 15);
+    if (m >= 15 && (op = lz_length(op, oend, m - 15)) == NULL) return NULL;
+    return op;
+}
+
+// Returns the compressed size, or 0 if the result would not fit in capacity bytes. table is scratch space of
+// 1 << LZ_HASH_BITS entries.
+inline size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity, uint16_t *table) {
+    if (size > 0xFFFF) return 0;
+    memset(table, 0, sizeof(uint16_t) << LZ_HASH_BITS);
+
+    uint8_t *op = dst;
+    const uint8_t *oend = dst + capacity;
+    size_t ip = 0;
+    size_t anchor = 0;
+
+    if (size > LZ_MATCH_LIMIT) {
+        size_t limit = size - LZ_MATCH_LIMIT;
+        while (ip < limit) {
+            uint32_t seq = lz_read32(src + ip);
+            uint32_t h = lz_hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint16_t)ip;
+            if (ref >= ip || lz_read32(src + ref) != seq) {
+                // Step faster through data that does not compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            size_t len = LZ_MIN_MATCH;
+            while (ip + len < size - LZ_LAST_LITERALS && src[ref + len] == src[ip + len]) ++len;
+            op = lz_sequence(op, oend, src + anchor, ip - anchor, ip - ref, len);
+            if (op == NULL) return 0;
+            ip += len;
+            anchor = ip;
+        }
+    }
+    op = lz_sequence(op, oend, src + anchor, size - anchor, 0, 0);
+    return op != NULL ? (size_t)(op - dst) : 0;
+}
+
+// Returns false unless src decodes to exactly size bytes
+inline bool lz_decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t size) {
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + srcSize;
+    size_t op = 0;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t len = token >> 4;
+        if (len == 15) {
+            uint8_t b;
+            do {
+                if (ip == iend) return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if ((size_t)(iend - ip) < len || size - op < len) return false;
+        memcpy(dst + op, ip, len);
+        ip += len;
+        op += len;
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return false;
+        len = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8_t b;
+            do {
+                if (ip == iend) return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if (size - op < len) return false;
+        // The match may overlap its own output
+        for (size_t i = 0; i < len; ++i, ++op) dst[op] = dst[op - offset];
+    }
+    return op == size;
+}
+
+}
+
+// Compression of the payloads of selected applications, enabled once both ends have agreed on it with
+// CapabilitiesMsg (see LinkCapabilities). A compressed message travels as a CompressedMsg of the comm service,
+// which carries the original application id, function and payload size, so no application function code is
+// taken. An application whose payloads repeatedly compress poorly is left alone for the next SKIP_COUNT
+// messages.
+//
+// deflate() keeps per-application state and must always be called from the same thread; MessageOutbox calls it
+// on the transport thread. inflate() may be called from any thread.
+class PayloadCompressor
+{
+public:
+    enum {
+        DEFAULT_THRESHOLD = 128,
+        POOR_RUN_LIMIT = 4,
+        SKIP_COUNT = 64,
+        MAX_APPS = 32
+    };
+
+    PayloadCompressor() : apps_(0), threshold_(DEFAULT_THRESHOLD) { reset(); }
+
+    // Returns a new compressed copy of message, or message itself when it is not worth compressing; the
+    // caller keeps ownership of message either way.
+    Message *deflate(const Message *message) {
+        update();
+        uint8_t id = message->appId();
+        uint16_t size = message->payloadSize();
+        if (!enabled(id) || size < threshold_) {
+            return const_cast<Message*>(message);
+        }
+        if (skip_[id] != 0) {
+            --skip_[id];
+            return const_cast<Message*>(message);
+        }
+
+        // Worth sending only if at least an eighth of the payload is saved
+        size_t capacity = size - size/8 - CompressedMsg::HEADER_SIZE;
+        Message *m = Message::alloc((uint16_t)(size - size/8));
+        size_t n = 0;
+        if (m != NULL) {
+            CompressedMsg *c = new (m) CompressedMsg;
+            n = detail::lz_compress(message->payload(), size, c->data(), capacity, table_);
+        }
+        if (n == 0) {
+            delete m;
+            if (++poorRun_[id] >= POOR_RUN_LIMIT) {
+                poorRun_[id] = 0;
+                skip_[id] = SKIP_COUNT;
+            }
+            return const_cast<Message*>(message);
+        }
+        poorRun_[id] = 0;
+        CompressedMsg *c = static_cast<CompressedMsg*>(m);
+        c->originalAppId_ = id;
+        c->originalAppFun_ = message->appFun();
+        c->originalSize_ = size;
+        c->payloadSize((uint16_t)(CompressedMsg::HEADER_SIZE + n));
+        return c;
+    }
+
+    // Whether the current agreement compresses the payloads of appId; same thread as deflate()
+    bool agreed(uint8_t appId) {
+        update();
+        return enabled(appId);
+    }
+
+    // Consumes a received message and returns it with its original payload, or NULL if it cannot be expanded
+    static Message *inflate(Message *message) {
+        if (message->appId() != COMM_SERVICE_ID || message->appFun() != CompressedMsg::ID) return message;
+        const CompressedMsg *c = static_cast<const CompressedMsg*>(message);
+        Message *m = NULL;
+        if (message->payloadSize() >= CompressedMsg::HEADER_SIZE) {
+            m = Message::alloc(c->originalSize_);
+        }
+        if (m == NULL) {
+            StatusFlags::instance().set(StatusFlags::MEMORY_ALLOCATION_FAILED);
+        } else if (detail::lz_decompress(c->data(), message->payloadSize() - CompressedMsg::HEADER_SIZE,
+                                         m->payload(), c->originalSize_)) {
+            m->payloadSize(c->originalSize_);
+            m->appId(c->originalAppId_);
+            m->appFun(c->originalAppFun_);
+            delete message;
+            return m;
+        } else {
+            StatusFlags::instance().set(StatusFlags::UNRECOGNIZED_MSG);
+        }
+        if (message->payloadSize() >= CompressedMsg::HEADER_SIZE) LinkCounters::instance().dropped(c->originalAppId_);
+        delete m;
+        delete message;
+        return NULL;
+    }
+
+private:
+    uint32_t apps_;
+    uint16_t threshold_;
+    uint8_t poorRun_[MAX_APPS];
+    uint8_t skip_[MAX_APPS];
+    uint16_t table_[1 << detail::LZ_HASH_BITS];
+
+    bool enabled(uint8_t appId) const {
+        return appId < MAX_APPS && (apps_ & (1u << appId)) != 0;
+    }
+
+    // Picks up a new agreement; the adaptive state starts over with it
+    void update() {
+        LinkCapabilities::Agreement a = LinkCapabilities::instance().agreement();
+        uint32_t apps = (a.capabilities_ & CapabilitiesMsg::CAP_COMPRESSION) != 0 ? a.compressedApps_ : 0;
+        uint16_t threshold = a.compressionThreshold_ > CompressedMsg::HEADER_SIZE ?
+            a.compressionThreshold_ : (uint16_t)DEFAULT_THRESHOLD;
+        if (apps == apps_ && threshold == threshold_) return;
+        apps_ = apps;
+        threshold_ = threshold;
+        reset();
+    }
+
+    void reset() {
+        for (size_t i = 0; i < MAX_APPS; ++i) {
+            poorRun_[i] = 0;
+            skip_[i] = 0;
+        }
+    }
+
+    PayloadCompressor(const PayloadCompressor &);
+    PayloadCompressor &operator=(const PayloadCompressor &);
+};
+
+}}
+
+#endif
@@ -0,0 +1,313 @@
+// PooledMemoryService.hpp : pooled message memory with thread caches
+
+#ifndef coder_tgtsvc_PooledMemoryService_hpp
+#define coder_tgtsvc_PooledMemoryService_hpp
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include "MemoryServiceBase.hpp"
+
+#if defined(_MSC_VER) && !defined(__GNUC__)
+#include <intrin.h>
+#endif
+
+namespace coder { namespace tgtsvc {
+
+#ifndef CODER_TGTSVC_CACHE_LINE_SIZE
+#define CODER_TGTSVC_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef CODER_TGTSVC_MAGAZINE_SIZE
+#define CODER_TGTSVC_MAGAZINE_SIZE 32
+#endif
+
+namespace detail {
+
+// Index of the most significant set bit; v must be non-zero
+inline uint8_t floorLog2(uint32_t v) {
+#if defined(__GNUC__)
+    return (uint8_t)(31 - __builtin_clz(v));
+#elif defined(_MSC_VER)
+    unsigned long r;
+    _BitScanReverse(&r, v);
+    return (uint8_t)r;
+#else
+    uint8_t r = 0;
+    while (v >>= 1) ++r;
+    return r;
+#endif
+}
+
+}
+
+// Thread-safe memory service. Every pool owns a fixed arena of chunks, carved on first use. Freed chunks go on
+// a lock-free stack whose head carries a tag, bumped by every pop, so that a stale head cannot be swapped back
+// in (ABA). Unless CODER_TGTSVC_NO_THREAD_CACHE is defined, each thread also keeps a magazine of free chunks
+// per pool and only touches the shared stack to refill or spill half a magazine. A cache is returned to the
+// shared stacks when its thread exits, and detached from the service when the service is destroyed. No thread may
+// allocate from or free to the service while it is being destroyed.
+template<uint8_t MAX_POOLS = 8>
+class PooledMemoryService : public MemoryServiceBase<PooledMemoryService<MAX_POOLS> >
+{
+    typedef MemoryServiceBase<PooledMemoryService<MAX_POOLS> > Base;
+    friend class MemoryServiceBase<PooledMemoryService<MAX_POOLS> >;
+
+public:
+
+    struct Statistics {
+        uint32_t capacity_;   // chunks in the arena
+        uint32_t carved_;     // chunks taken from the arena so far; an upper bound on the most in use at once
+        uint32_t failures_;   // requests refused because the arena was exhausted
+    };
+
+    // chunkCounts[i] is the number of chunks reserved for pool i
+    PooledMemoryService(const uint16_t *poolSizes, const uint32_t *chunkCounts, uint8_t poolCnt) :
+        Base(poolSizes, poolCnt)
+    {
+        assert(poolCnt <= MAX_POOLS);
+
+        // firstPool_[b] is the first pool large enough for the smallest request of size class b, i.e. of
+        // requests in (2^(b-1), 2^b]; whichPool starts its search there.
+        uint8_t r = 0;
+        for (uint8_t b = 0; b < SIZE_CLASS_COUNT; ++b) {
+            uint32_t smallest = b == 0 ? 1 : (1u << (b-1)) + 1;
+            while (r < poolCnt && this->poolSize(r) < smallest) ++r;
+            firstPool_[b] = r;
+        }
+
+        for (uint8_t i = 0; i < poolCnt; ++i) {
+            Pool &p = pools_[i];
+            p.stride_ = sizeof(void*) + this->poolSize(i);
+            p.arena_ = static_cast<uint8_t*>(malloc(p.stride_ * chunkCounts[i]));
+            p.capacity_ = p.arena_ != NULL ? chunkCounts[i] : 0;
+            p.head_.store(NIL, std::memory_order_relaxed);
+            p.carved_.store(0, std::memory_order_relaxed);
+            p.failures_.store(0, std::memory_order_relaxed);
+        }
+#ifndef CODER_TGTSVC_NO_THREAD_CACHE
+        generation_ = nextGeneration().fetch_add(1, std::memory_order_relaxed) + 1;
+        caches_ = NULL;
+        // Constructed before this service, so destroyed after it
+        cacheMutex();
+#endif
+    }
+
+    ~PooledMemoryService() {
+#ifndef CODER_TGTSVC_NO_THREAD_CACHE
+        {
+            // Chunks in the caches belong to the arenas freed below; the threads start over if they come back
+            std::lock_guard<std::mutex> lock(cacheMutex());
+            for (ThreadCache *tc = caches_; tc != NULL; tc = tc->next_) {
+                tc->owner_.store(NULL, std::memory_order_relaxed);
+            }
+        }
+#endif
+        for (uint8_t i = 0; i < this->poolCount(); ++i) {
+            ::free(pools_[i].arena_);
+        }
+    }
+
+    Statistics statistics(uint8_t poolIdx) const {
+        assert(poolIdx < this->poolCount());
+        const Pool &p = pools_[poolIdx];
+        Statistics s;
+        s.capacity_ = p.capacity_;
+        s.carved_ = p.carved_.load(std::memory_order_relaxed);
+        s.failures_ = p.failures_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    enum {
+        MAGAZINE_SIZE = CODER_TGTSVC_MAGAZINE_SIZE,
+        SIZE_CLASS_COUNT = 17
+    };
+    static const uint32_t NIL = 0xffffffffu;
+
+    struct Pool {
+        uint8_t *arena_;
+        size_t stride_;
+        uint32_t capacity_;
+        alignas(CODER_TGTSVC_CACHE_LINE_SIZE) std::atomic<uint64_t> head_;  // (tag << 32) | chunk index
+        std::atomic<uint32_t> carved_;
+        std::atomic<uint32_t> failures_;
+    };
+
+    Pool pools_[MAX_POOLS];
+    uint8_t firstPool_[SIZE_CLASS_COUNT];
+
+    // MemoryServiceBase interface
+
+    uint8_t whichPool(size_t requestSize) {
+        if (requestSize > 0xFFFF) return this->poolCount();
+        uint8_t sizeClass = requestSize <= 1 ? 0 : detail::floorLog2((uint32_t)requestSize - 1) + 1;
+        uint8_t r = firstPool_[sizeClass];
+        while (r < this->poolCount() && this->poolSize(r) < requestSize) ++r;
+        return r;
+    }
+
+    detail::Chunk *popChunk(uint8_t poolIdx) {
+#ifndef CODER_TGTSVC_NO_THREAD_CACHE
+        if (Magazine *m = magazine(poolIdx)) {
+            if (m->count_ == 0) {
+                while (m->count_ < MAGAZINE_SIZE/2) {
+                    uint32_t i = pop(pools_[poolIdx]);
+                    if (i == NIL) break;
+                    m->chunks_[m->count_++] = i;
+                }
+            }
+            return m->count_ != 0 ? chunk(pools_[poolIdx], m->chunks_[--m->count_]) : NULL;
+        }
+#endif
+        uint32_t i = pop(pools_[poolIdx]);
+        return i != NIL ? chunk(pools_[poolIdx], i) : NULL;
+    }
+
+    detail::Chunk *allocChunk(uint8_t poolIdx) {
+        Pool &p = pools_[poolIdx];
+        uint32_t i = p.carved_.load(std::memory_order_relaxed);
+        do {
+            if (i >= p.capacity_) {
+                // Chunks parked in other threads' magazines are not reclaimed here
+                p.failures_.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+        } while (!p.carved_.compare_exchange_weak(i, i+1, std::memory_order_relaxed));
+        return chunk(p, i);
+    }
+
+    void pushChunk(detail::Chunk *c) {
+        uint8_t poolIdx = c->poolIndex();
+        Pool &p = pools_[poolIdx];
+        uint32_t i = (uint32_t)((c->header() - p.arena_) / p.stride_);
+#ifndef CODER_TGTSVC_NO_THREAD_CACHE
+        if (Magazine *m = magazine(poolIdx)) {
+            if (m->count_ == MAGAZINE_SIZE) {
+                while (m->count_ > MAGAZINE_SIZE/2) push(p, m->chunks_[--m->count_]);
+            }
+            m->chunks_[m->count_++] = i;
+            return;
+        }
+#endif
+        push(p, i);
+    }
+
+    // Shared free stack; the link to the next free chunk is kept in the chunk's first word
+
+    static detail::Chunk *chunk(Pool &p, uint32_t i) {
+        return detail::Chunk::fromHeader(p.arena_ + (size_t)i * p.stride_);
+    }
+
+    static std::atomic<uint32_t> &link(Pool &p, uint32_t i) {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(chunk(p, i));
+    }
+
+    static void push(Pool &p, uint32_t i) {
+        uint64_t head = p.head_.load(std::memory_order_relaxed);
+        do {
+            link(p, i).store((uint32_t)head, std::memory_order_relaxed);
+        } while (!p.head_.compare_exchange_weak(head, (head & ~(uint64_t)NIL) | i,
+                                                std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    static uint32_t pop(Pool &p) {
+        uint64_t head = p.head_.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t i = (uint32_t)head;
+            if (i == NIL) return NIL;
+            uint32_t next = link(p, i).load(std::memory_order_relaxed);
+            uint64_t tag = (head >> 32) + 1;
+            if (p.head_.compare_exchange_weak(head, (tag << 32) | next,
+                                              std::memory_order_acquire, std::memory_order_acquire)) {
+                return i;
+            }
+        }
+    }
+
+#ifndef CODER_TGTSVC_NO_THREAD_CACHE
+
+    struct Magazine {
+        uint32_t count_;
+        uint32_t chunks_[MAGAZINE_SIZE];
+    };
+
+    // A thread caches chunks for the first service it allocates from; any other service bypasses the cache.
+    // The cache is keyed by the service's generation as well as its address, so a service created where a
+    // destroyed one used to be never inherits its chunks. owner_ is only cleared by another thread, under
+    // cacheMutex(), when the service is destroyed.
+    struct ThreadCache {
+        ThreadCache() : generation_(0), next_(NULL) { owner_.store(NULL, std::memory_order_relaxed); }
+
+        ~ThreadCache() {
+            std::lock_guard<std::mutex> lock(cacheMutex());
+            PooledMemoryService *owner = owner_.load(std::memory_order_relaxed);
+            if (owner == NULL) return;
+            for (uint8_t i = 0; i < owner->poolCount(); ++i) {
+                Magazine &m = magazines_[i];
+                while (m.count_ != 0) push(owner->pools_[i], m.chunks_[--m.count_]);
+            }
+            owner->detach(this);
+        }
+
+        std::atomic<PooledMemoryService*> owner_;
+        uint64_t generation_;
+        ThreadCache *next_;
+        Magazine magazines_[MAX_POOLS];
+    };
+
+    uint64_t generation_;
+    ThreadCache *caches_;   // guarded by cacheMutex()
+
+    static std::mutex &cacheMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::atomic<uint64_t> &nextGeneration() {
+        static std::atomic<uint64_t> generation(0);
+        return generation;
+    }
+
+    static ThreadCache &threadCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    Magazine *magazine(uint8_t poolIdx) {
+        ThreadCache &tc = threadCache();
+        PooledMemoryService *owner = tc.owner_.load(std::memory_order_relaxed);
+        if (owner == this && tc.generation_ == generation_) return &tc.magazines_[poolIdx];
+        if (owner != NULL) return NULL;
+
+        std::lock_guard<std::mutex> lock(cacheMutex());
+        for (uint8_t i = 0; i < MAX_POOLS; ++i) tc.magazines_[i].count_ = 0;
+        tc.generation_ = generation_;
+        tc.next_ = caches_;
+        caches_ = &tc;
+        tc.owner_.store(this, std::memory_order_relaxed);
+        return &tc.magazines_[poolIdx];
+    }
+
+    // Called with cacheMutex() held
+    void detach(ThreadCache *tc) {
+        for (ThreadCache **p = &caches_; *p != NULL; p = &(*p)->next_) {
+            if (*p == tc) {
+                *p = tc->next_;
+                break;
+            }
+        }
+        tc->owner_.store(NULL, std::memory_order_relaxed);
+    }
+
+#endif
+
+    PooledMemoryService(const PooledMemoryService &);
+    PooledMemoryService &operator=(const PooledMemoryService &);
+};
+
+}}
+
+#endif
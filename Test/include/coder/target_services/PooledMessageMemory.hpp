@@ -0,0 +1,88 @@
+// PooledMessageMemory.hpp : message allocation from a PooledMemoryService
+
+#ifndef coder_tgtsvc_PooledMessageMemory_hpp
+#define coder_tgtsvc_PooledMessageMemory_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include "Message.hpp"
+#include "PooledMemoryService.hpp"
+
+// Defines Message's allocation functions on top of a PooledMemoryService, for targets that build the target
+// services from source instead of linking the memory service of the prebuilt library. Include it in exactly one
+// translation unit of such a target. Pool sizes are in bytes, including the Message header, and must be
+// increasing multiples of the pointer size; the last one must hold ABSOLUTE_MAXIMUM_PAYLOAD.
+#ifndef CODER_TGTSVC_MESSAGE_POOL_SIZES
+#define CODER_TGTSVC_MESSAGE_POOL_SIZES \
+    64, 128, 256, 512, 1024, \
+    (sizeof(coder::tgtsvc::Message) + coder::tgtsvc::Message::ABSOLUTE_MAXIMUM_PAYLOAD + sizeof(void*) - 1) / \
+        sizeof(void*) * sizeof(void*)
+#endif
+
+#ifndef CODER_TGTSVC_MESSAGE_POOL_CHUNKS
+#define CODER_TGTSVC_MESSAGE_POOL_CHUNKS 512, 512, 256, 128, 64, 64
+#endif
+
+namespace coder { namespace tgtsvc {
+
+namespace detail {
+
+typedef PooledMemoryService<> MessageMemoryService;
+
+// Never destroyed, so messages freed while static objects are torn down still go back to their pools
+inline MessageMemoryService &messageMemory() {
+    static const uint16_t poolSizes[] = { CODER_TGTSVC_MESSAGE_POOL_SIZES };
+    static const uint32_t chunkCounts[] = { CODER_TGTSVC_MESSAGE_POOL_CHUNKS };
+    static_assert(sizeof(poolSizes)/sizeof(poolSizes[0]) == sizeof(chunkCounts)/sizeof(chunkCounts[0]),
+                  "CODER_TGTSVC_MESSAGE_POOL_SIZES and CODER_TGTSVC_MESSAGE_POOL_CHUNKS differ in length");
+    static std::aligned_storage<sizeof(MessageMemoryService), alignof(MessageMemoryService)>::type storage;
+    static MessageMemoryService *memory = new (&storage)
+        MessageMemoryService(poolSizes, chunkCounts, (uint8_t)(sizeof(poolSizes)/sizeof(poolSizes[0])));
+    return *memory;
+}
+
+}
+
+// Like the rest of the target services, these return NULL rather than throw when the pools are exhausted
+
+void *Message::operator new(size_t size) {
+    return detail::messageMemory().alloc(size);
+}
+
+void Message::operator delete(void *ptr) throw() {
+    if (ptr != NULL) detail::messageMemory().free(ptr);
+}
+
+void *Message::operator new(size_t size, const std::nothrow_t &) throw() {
+    return detail::messageMemory().alloc(size);
+}
+
+void Message::operator delete(void *ptr, const std::nothrow_t &) throw() {
+    if (ptr != NULL) detail::messageMemory().free(ptr);
+}
+
+Message *Message::alloc(uint16_t payloadSize) {
+    if (payloadSize > maxPayloadCapacity()) {
+        StatusFlags::instance().set(StatusFlags::MEMORY_ALLOCATION_FAILED);
+        return NULL;
+    }
+    void *p = detail::messageMemory().alloc(memoryNeeded(payloadSize));
+    if (p == NULL) return NULL;
+    Message *m = new (p) Message;
+    m->payloadSize(payloadSize);
+    return m;
+}
+
+uint16_t Message::payloadCapacity() const {
+    return (uint16_t)(detail::messageMemory().capacity(this) - sizeof(Message));
+}
+
+uint16_t Message::maxPayloadCapacity() {
+    return (uint16_t)(detail::messageMemory().maxCapacity() - sizeof(Message));
+}
+
+}}
+
+#endif
@@ -13,7 +13,9 @@ namespace coder { namespace tgtsvc {
 enum PacketId {
     CONNECT_ID = 0,
     ACK_ID = 1,
-    DATA_ID = 2
+    DATA_ID = 2,
+    SELECTIVE_ACK_ID = 3,
+    DATA_CRC32C_ID = 4
 };
 
 enum {
@@ -35,6 +37,30 @@ struct Ack
     uint8_t sequence_; 
 };
 
+// Ack listing, besides the next expected sequence number, which of the following MAX_RX_WINDOW_SIZE packets
+// have already been received: bit i of mask_ stands for sequence_ + 1 + i.
+struct SelectiveAck
+{
+    enum {
+        ID = SELECTIVE_ACK_ID,
+        MASK_SIZE = MAX_RX_WINDOW_SIZE / 8
+    };
+
+    SelectiveAck() : id_(ID), sequence_(0) {
+        for (size_t i = 0; i < MASK_SIZE; ++i) mask_[i] = 0;
+    }
+
+    bool received(size_t i) const { return (mask_[i / 8] & (1 << (i % 8))) != 0; }
+    void received(size_t i, bool v) {
+        if (v) mask_[i / 8] |= (uint8_t)(1 << (i % 8));
+        else mask_[i / 8] &= (uint8_t)~(1 << (i % 8));
+    }
+
+    uint8_t id_;
+    uint8_t sequence_;
+    uint8_t mask_[MASK_SIZE];
+};
+
 struct DataHeader
 {
     enum {
@@ -52,6 +78,34 @@ struct DataHeader
     uint8_t crc_;      
 };
 
+// Data packet protected by a CRC-32C (see crc32c.hpp) instead of crc8. Sent only to a peer that offered it in
+// its ConnectEx. The checksum covers the first four bytes of the header and the data, and is stored least
+// significant byte first.
+struct DataHeaderCrc32c
+{
+    enum {
+        ID = DATA_CRC32C_ID,
+    };
+
+    DataHeaderCrc32c() : id_(ID), sequence_(0), dataSize_(0), reserved_(0) { crc(0); }
+
+    uint8_t *data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    const uint8_t *data() const { return const_cast<DataHeaderCrc32c*>(this)->data(); }
+
+    uint32_t crc() const {
+        return (uint32_t)crc_[0] | ((uint32_t)crc_[1] << 8) | ((uint32_t)crc_[2] << 16) | ((uint32_t)crc_[3] << 24);
+    }
+    void crc(uint32_t v) {
+        for (size_t i = 0; i < 4; ++i) crc_[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    uint8_t id_;
+    uint8_t sequence_;
+    uint8_t dataSize_;
+    uint8_t reserved_;
+    uint8_t crc_[4];
+};
+
 struct Connect
 {
     enum {
@@ -66,6 +120,24 @@ struct Connect
     uint8_t windowSize_; 
 };
 
+// Connect followed by the options the sender supports. A receiver that only knows Connect reads the first two
+// bytes and sees no options; a Connect without the options byte offers none.
+struct ConnectEx
+{
+    enum {
+        ID = CONNECT_ID,
+        OPTION_CRC32C = 0x01     // DataHeaderCrc32c packets are accepted
+    };
+
+    ConnectEx() : id_(ID), windowSize_(0), options_(0) {}
+    ConnectEx(uint8_t windowSize, uint8_t options) :
+        id_(ID), windowSize_(windowSize), options_(options) {}
+
+    uint8_t id_;
+    uint8_t windowSize_;
+    uint8_t options_;
+};
+
 }}
 
 #endif
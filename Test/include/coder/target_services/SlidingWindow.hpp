@@ -0,0 +1,433 @@
+// SlidingWindow.hpp : sliding-window reliable transport
+
+#ifndef coder_tgtsvc_SlidingWindow_hpp
+#define coder_tgtsvc_SlidingWindow_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include "SerialPackets.hpp"
+#include "crc8.hpp"
+#include "crc32c.hpp"
+
+namespace coder { namespace tgtsvc {
+
+// Reliable, in-order packet transport over an unreliable link, using the packets of SerialPackets.hpp.
+//
+// Up to WINDOW data packets are in flight at once (no more than the window announced by the peer in its
+// Connect). The receiver buffers packets that arrive out of order and answers with an Ack carrying the next
+// sequence number it expects, or with a SelectiveAck that also lists the later packets it already holds.
+// Packets reported missing behind a selectively acknowledged one are retransmitted right away; every other
+// packet is retransmitted when its timer expires. The retransmit timeout follows the measured round trip
+// time (smoothed mean plus four deviations, samples of retransmitted packets being ignored) and doubles on
+// each expiry.
+//
+// The caller frames the packets and supplies the time. Link must provide
+//     bool write(const uint8_t *packet, size_t size);      // false if the packet cannot be sent now
+//     void deliver(const uint8_t *data, size_t size);      // received data, in order
+// Time is a free-running uint32_t tick count (milliseconds unless the timeouts are given in another unit).
+//
+// Packets are checked with crc8 unless both ends call offerCrc32c() before connecting: the offer travels in a
+// ConnectEx, and once the peer's offer has arrived, packets carrying at least the given amount of data are sent
+// as DataHeaderCrc32c. Its header is four bytes longer, so the largest packets, above MAX_CRC32C_DATA_SIZE, keep
+// crc8.
+template<class Link, size_t WINDOW = MAX_RX_WINDOW_SIZE>
+class SlidingWindowTransport
+{
+public:
+    enum {
+        MAX_DATA_SIZE = MAX_SERIAL_PACKET_SIZE - sizeof(DataHeader),
+        MAX_CRC32C_DATA_SIZE = MAX_SERIAL_PACKET_SIZE - sizeof(DataHeaderCrc32c),
+        DEFAULT_CRC32C_MIN_DATA_SIZE = 16
+    };
+
+    static_assert(WINDOW >= 2 && WINDOW <= MAX_RX_WINDOW_SIZE && (WINDOW & (WINDOW - 1)) == 0,
+                  "SlidingWindowTransport window must be a power of two no larger than MAX_RX_WINDOW_SIZE");
+
+    explicit SlidingWindowTransport(Link &link, uint32_t initialRto = 200, uint32_t minRto = 10, uint32_t maxRto = 5000) :
+        link_(link), initialRto_(initialRto), minRto_(minRto), maxRto_(maxRto), crc32cMinSize_(0)
+    {
+        reset();
+    }
+
+    void reset() {
+        txBase_ = txNext_ = txEnd_ = 0;
+        rxBase_ = 0;
+        peerWindow_ = WINDOW;
+        ackPending_ = false;
+        connectPending_ = false;
+        peerCrc32c_ = false;
+        rttValid_ = false;
+        srtt_ = rttvar_ = 0;
+        rto_ = initialRto_;
+        retransmissions_ = 0;
+        for (size_t i = 0; i < WINDOW; ++i) {
+            tx_[i].acked = true;
+            rx_[i].present = false;
+        }
+    }
+
+    // Announce the receive window to the peer on the next poll.
+    void connect() { connectPending_ = true; }
+
+    // Accept DataHeaderCrc32c packets, and send them to a peer that does too for at least minDataSize bytes of
+    // data. Takes effect with the next connect().
+    void offerCrc32c(size_t minDataSize = DEFAULT_CRC32C_MIN_DATA_SIZE) {
+        crc32cMinSize_ = minDataSize > 0 ? minDataSize : 1;
+    }
+
+    // True once both ends have offered CRC-32C
+    bool crc32cAgreed() const { return crc32cMinSize_ != 0 && peerCrc32c_; }
+
+    // Number of data packets that can be queued by send().
+    size_t sendSpace() const { return WINDOW - (uint8_t)(txEnd_ - txBase_); }
+
+    // True once every queued packet has been acknowledged.
+    bool idle() const { return txBase_ == txEnd_; }
+
+    uint32_t rto() const { return rto_; }
+    uint32_t retransmissions() const { return retransmissions_; }
+
+    bool send(const uint8_t *data, size_t size) {
+        if (size > MAX_DATA_SIZE || sendSpace() == 0) return false;
+
+        TxSlot &slot = tx_[txEnd_ % WINDOW];
+        if (crc32cAgreed() && size >= crc32cMinSize_ && size <= MAX_CRC32C_DATA_SIZE) {
+            DataHeaderCrc32c *h = new (slot.packet) DataHeaderCrc32c;
+            h->sequence_ = txEnd_;
+            h->dataSize_ = (uint8_t)size;
+            memcpy(h->data(), data, size);
+            h->crc(packetCrc(*h));
+            slot.size = (uint8_t)(sizeof(DataHeaderCrc32c) + size);
+        }
+        else {
+            DataHeader *h = new (slot.packet) DataHeader;
+            h->sequence_ = txEnd_;
+            h->dataSize_ = (uint8_t)size;
+            memcpy(h->data(), data, size);
+            h->crc_ = packetCrc(*h);
+            slot.size = (uint8_t)(sizeof(DataHeader) + size);
+        }
+        slot.acked = false;
+        slot.sent = false;
+        slot.resend = false;
+        slot.retransmitted = false;
+        ++txEnd_;
+        return true;
+    }
+
+    void receive(const uint8_t *packet, size_t size, uint32_t now) {
+        if (size < 2) return;
+        switch (packet[0]) {
+        case CONNECT_ID:
+            if (size >= sizeof(Connect)) {
+                const Connect *c = reinterpret_cast<const Connect*>(packet);
+                peerWindow_ = c->windowSize_ == 0 ? 1 : (c->windowSize_ < WINDOW ? c->windowSize_ : WINDOW);
+                peerCrc32c_ = size >= sizeof(ConnectEx) &&
+                    (reinterpret_cast<const ConnectEx*>(packet)->options_ & ConnectEx::OPTION_CRC32C) != 0;
+            }
+            break;
+
+        case ACK_ID:
+            acknowledge(packet[1], now);
+            break;
+
+        case SELECTIVE_ACK_ID:
+            if (size >= sizeof(SelectiveAck)) {
+                selectiveAcknowledge(*reinterpret_cast<const SelectiveAck*>(packet), now);
+            }
+            break;
+
+        case DATA_ID:
+            if (size >= sizeof(DataHeader)) {
+                const DataHeader &h = *reinterpret_cast<const DataHeader*>(packet);
+                if (h.dataSize_ <= MAX_DATA_SIZE && sizeof(DataHeader) + h.dataSize_ <= size &&
+                    packetCrc(h) == h.crc_) {
+                    receiveData(h.sequence_, h.data(), h.dataSize_);
+                }
+            }
+            break;
+
+        case DATA_CRC32C_ID:
+            if (crc32cMinSize_ != 0 && size >= sizeof(DataHeaderCrc32c)) {
+                const DataHeaderCrc32c &h = *reinterpret_cast<const DataHeaderCrc32c*>(packet);
+                if (h.dataSize_ <= MAX_CRC32C_DATA_SIZE && sizeof(DataHeaderCrc32c) + h.dataSize_ <= size &&
+                    packetCrc(h) == h.crc()) {
+                    receiveData(h.sequence_, h.data(), h.dataSize_);
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void poll(uint32_t now) {
+        if (connectPending_) {
+            bool written;
+            if (crc32cMinSize_ != 0) {
+                ConnectEx c((uint8_t)WINDOW, ConnectEx::OPTION_CRC32C);
+                written = link_.write(reinterpret_cast<const uint8_t*>(&c), sizeof(c));
+            }
+            else {
+                Connect c(CONNECT_ID, (uint8_t)WINDOW);
+                written = link_.write(reinterpret_cast<const uint8_t*>(&c), sizeof(c));
+            }
+            if (written) connectPending_ = false;
+        }
+
+        bool expired = false;
+        for (uint8_t seq = txBase_; seq != txNext_; ++seq) {
+            TxSlot &slot = tx_[seq % WINDOW];
+            if (slot.acked) continue;
+            bool timedOut = (uint32_t)(now - slot.sentAt) >= rto_;
+            if (!slot.resend && !timedOut) continue;
+            if (!link_.write(slot.packet, slot.size)) break;
+            expired = expired || (timedOut && !slot.resend);
+            slot.sentAt = now;
+            slot.resend = false;
+            slot.retransmitted = true;
+            ++retransmissions_;
+        }
+        if (expired) {
+            rto_ = rto_ * 2 < maxRto_ ? rto_ * 2 : maxRto_;
+        }
+
+        while (txNext_ != txEnd_ && (uint8_t)(txNext_ - txBase_) < peerWindow_) {
+            TxSlot &slot = tx_[txNext_ % WINDOW];
+            if (!link_.write(slot.packet, slot.size)) break;
+            slot.sent = true;
+            slot.sentAt = now;
+            ++txNext_;
+        }
+
+        if (ackPending_) {
+            sendAck();
+        }
+    }
+
+private:
+    struct TxSlot {
+        uint8_t packet[MAX_SERIAL_PACKET_SIZE];
+        uint8_t size;
+        bool acked;
+        bool sent;
+        bool resend;
+        bool retransmitted;
+        uint32_t sentAt;
+    };
+
+    struct RxSlot {
+        uint8_t data[MAX_DATA_SIZE];
+        uint8_t size;
+        bool present;
+    };
+
+    Link &link_;
+    uint32_t initialRto_;
+    uint32_t minRto_;
+    uint32_t maxRto_;
+
+    TxSlot tx_[WINDOW];
+    uint8_t txBase_;    // oldest unacknowledged sequence number
+    uint8_t txNext_;    // next sequence number to transmit for the first time
+    uint8_t txEnd_;     // next sequence number to assign
+    uint8_t peerWindow_;
+
+    RxSlot rx_[WINDOW];
+    uint8_t rxBase_;    // next sequence number to deliver
+    bool ackPending_;
+    bool connectPending_;
+    size_t crc32cMinSize_;  // 0 unless CRC-32C was offered
+    bool peerCrc32c_;
+
+    bool rttValid_;
+    int32_t srtt_;      // scaled by 8
+    int32_t rttvar_;    // scaled by 4
+    uint32_t rto_;
+    uint32_t retransmissions_;
+
+    static uint8_t packetCrc(const DataHeader &h) {
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(&h);
+        const uint8_t zero = 0;
+        uint8_t crc = crc8(p, p + offsetof(DataHeader, crc_));
+        crc = crc8(&zero, &zero + 1, crc);
+        return crc8(h.data(), h.data() + h.dataSize_, crc);
+    }
+
+    static uint32_t packetCrc(const DataHeaderCrc32c &h) {
+        const uint8_t *p = reinterpret_cast<const uint8_t*>(&h);
+        uint32_t crc = ::crc32c(p, p + offsetof(DataHeaderCrc32c, crc_));
+        return ::crc32c(h.data(), h.data() + h.dataSize_, crc);
+    }
+
+    bool inFlight(uint8_t seq) const { return (uint8_t)(seq - txBase_) < (uint8_t)(txNext_ - txBase_); }
+
+    void sample(TxSlot &slot, uint32_t now) {
+        if (slot.retransmitted) return;
+        int32_t r = (int32_t)(now - slot.sentAt);
+        if (!rttValid_) {
+            srtt_ = r << 3;
+            rttvar_ = r << 1;
+            rttValid_ = true;
+        }
+        else {
+            int32_t err = r - (srtt_ >> 3);
+            srtt_ += err;
+            if (err < 0) err = -err;
+            rttvar_ += err - (rttvar_ >> 2);
+        }
+        uint32_t rto = (uint32_t)((srtt_ >> 3) + (rttvar_ > 1 ? rttvar_ : 1));
+        rto_ = rto < minRto_ ? minRto_ : (rto > maxRto_ ? maxRto_ : rto);
+    }
+
+    void acknowledge(uint8_t next, uint32_t now) {
+        if ((uint8_t)(next - txBase_) > (uint8_t)(txNext_ - txBase_)) return;
+        while (txBase_ != next) {
+            TxSlot &slot = tx_[txBase_ % WINDOW];
+            if (!slot.acked) {
+                slot.acked = true;
+                sample(slot, now);
+            }
+            ++txBase_;
+        }
+    }
+
+    void selectiveAcknowledge(const SelectiveAck &ack, uint32_t now) {
+        // A stale or corrupt ack outside [txBase_, txNext_] would walk the whole sequence space below
+        if ((uint8_t)(ack.sequence_ - txBase_) > (uint8_t)(txNext_ - txBase_)) return;
+        acknowledge(ack.sequence_, now);
+
+        uint8_t highest = ack.sequence_;
+        for (size_t i = 0; i + 1 < WINDOW; ++i) {
+            uint8_t seq = (uint8_t)(ack.sequence_ + 1 + i);
+            if (!ack.received(i) || !inFlight(seq)) continue;
+            TxSlot &slot = tx_[seq % WINDOW];
+            if (!slot.acked) {
+                slot.acked = true;
+                sample(slot, now);
+            }
+            highest = seq;
+        }
+        for (uint8_t seq = txBase_; seq != highest; ++seq) {
+            TxSlot &slot = tx_[seq % WINDOW];
+            if (!slot.acked && !slot.retransmitted) slot.resend = true;
+        }
+    }
+
+    // Called with a packet whose checksum is good
+    void receiveData(uint8_t sequence, const uint8_t *data, uint8_t size) {
+        ackPending_ = true;
+        uint8_t offset = (uint8_t)(sequence - rxBase_);
+        if (offset >= WINDOW) return;
+
+        RxSlot &slot = rx_[sequence % WINDOW];
+        if (!slot.present) {
+            memcpy(slot.data, data, size);
+            slot.size = size;
+            slot.present = true;
+        }
+        while (rx_[rxBase_ % WINDOW].present) {
+            RxSlot &next = rx_[rxBase_ % WINDOW];
+            next.present = false;
+            ++rxBase_;
+            link_.deliver(next.data, next.size);
+        }
+    }
+
+    void sendAck() {
+        SelectiveAck sack;
+        sack.sequence_ = rxBase_;
+        bool selective = false;
+        for (size_t i = 0; i + 1 < WINDOW; ++i) {
+            if (rx_[(uint8_t)(rxBase_ + 1 + i) % WINDOW].present) {
+                sack.received(i, true);
+                selective = true;
+            }
+        }
+        bool sent;
+        if (selective) {
+            sent = link_.write(reinterpret_cast<const uint8_t*>(&sack), sizeof(sack));
+        }
+        else {
+            Ack ack;
+            ack.sequence_ = rxBase_;
+            sent = link_.write(reinterpret_cast<const uint8_t*>(&ack), sizeof(ack));
+        }
+        if (sent) ackPending_ = false;
+    }
+
+    SlidingWindowTransport(const SlidingWindowTransport &);
+    SlidingWindowTransport &operator=(const SlidingWindowTransport &);
+};
+
+// In-process packet channel that loses and reorders packets, to exercise SlidingWindowTransport without a
+// real link. Drop and reorder rates are in percent; a reordered packet is queued ahead of the previous one.
+template<size_t QUEUE = 256>
+class LossyLoopback
+{
+public:
+    LossyLoopback(unsigned dropPercent = 0, unsigned reorderPercent = 0, uint32_t seed = 1) :
+        dropPercent_(dropPercent), reorderPercent_(reorderPercent), random_(seed), head_(0), count_(0),
+        written_(0), dropped_(0) {}
+
+    bool write(const uint8_t *packet, size_t size) {
+        if (count_ == QUEUE || size > MAX_SERIAL_PACKET_SIZE) return false;
+        ++written_;
+        if (next() % 100 < dropPercent_) {
+            ++dropped_;
+            return true;
+        }
+        Slot &slot = slots_[(head_ + count_) % QUEUE];
+        memcpy(slot.packet, packet, size);
+        slot.size = size;
+        ++count_;
+        if (count_ > 1 && next() % 100 < reorderPercent_) {
+            Slot tmp = slot;
+            Slot &prev = slots_[(head_ + count_ - 2) % QUEUE];
+            slot = prev;
+            prev = tmp;
+        }
+        return true;
+    }
+
+    bool read(uint8_t *packet, size_t &size) {
+        if (count_ == 0) return false;
+        Slot &slot = slots_[head_];
+        memcpy(packet, slot.packet, slot.size);
+        size = slot.size;
+        head_ = (head_ + 1) % QUEUE;
+        --count_;
+        return true;
+    }
+
+    bool empty() const { return count_ == 0; }
+    uint32_t written() const { return written_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    struct Slot {
+        uint8_t packet[MAX_SERIAL_PACKET_SIZE];
+        size_t size;
+    };
+
+    unsigned dropPercent_;
+    unsigned reorderPercent_;
+    uint32_t random_;
+    size_t head_;
+    size_t count_;
+    uint32_t written_;
+    uint32_t dropped_;
+    Slot slots_[QUEUE];
+
+    uint32_t next() {
+        random_ = random_ * 1664525u + 1013904223u;
+        return random_ >> 16;
+    }
+};
+
+}}
+
+#endif
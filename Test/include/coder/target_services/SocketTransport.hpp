@@ -0,0 +1,113 @@
+// SocketTransport.hpp : POSIX socket transport
+
+#ifndef coder_tgtsvc_SocketTransport_hpp
+#define coder_tgtsvc_SocketTransport_hpp
+
+#ifndef _WIN32
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace coder { namespace tgtsvc {
+
+// Blocking stream socket with the byte transport interface used by LinkBenchmark; connects to a UNIX domain
+// socket or to a TCP port, or adopts an accepted descriptor on the target side.
+class SocketTransport
+{
+public:
+    SocketTransport() : fd_(-1) {}
+    explicit SocketTransport(int fd) : fd_(fd) {}
+    ~SocketTransport() { close(); }
+
+    bool connectUnix(const char *path) {
+        close();
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) return false;
+        strcpy(addr.sun_path, path);
+        return open(AF_UNIX, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+
+    bool connectTcp(uint16_t port, const char *host = "127.0.0.1") {
+        close();
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+        if (!open(AF_INET, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) return false;
+        // Test messages are small; do not let Nagle hold them back
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    bool connected() const { return fd_ >= 0; }
+
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool write(const uint8_t *data, size_t size) {
+        while (size != 0) {
+            ssize_t n = ::send(fd_, data, size, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+    size_t read(uint8_t *data, size_t size, uint32_t timeoutMs) {
+        pollfd p;
+        p.fd = fd_;
+        p.events = POLLIN;
+        p.revents = 0;
+        int r;
+        do {
+            r = ::poll(&p, 1, (int)timeoutMs);
+        } while (r < 0 && errno == EINTR);
+        if (r <= 0) return 0;
+        ssize_t n;
+        do {
+            n = ::recv(fd_, data, size, 0);
+        } while (n < 0 && errno == EINTR);
+        return n > 0 ? (size_t)n : 0;
+    }
+
+private:
+    int fd_;
+
+    bool open(int family, const sockaddr *addr, socklen_t len) {
+        fd_ = ::socket(family, SOCK_STREAM, 0);
+        if (fd_ < 0) return false;
+        if (::connect(fd_, addr, len) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    SocketTransport(const SocketTransport &);
+    SocketTransport &operator=(const SocketTransport &);
+};
+
+}}
+
+#endif
+
+#endif
@@ -14,7 +14,8 @@ struct CODER_TARGET_SERVICES_EXPORT_CLASS StatusFlags
         MEMORY_ALLOCATION_FAILED = 0x01,
         COMM_SEND_FAILED         = 0x02,
         UNRECOGNIZED_MSG         = 0x04,
-        MSG_APP_ID_OUT_OF_RANGE  = 0x08
+        MSG_APP_ID_OUT_OF_RANGE  = 0x08,
+        APP_QUEUE_FULL           = 0x10
     };
 
     void set(Bit b) { bits_ |= (uint32_t)b; }
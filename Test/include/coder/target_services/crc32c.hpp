@@ -0,0 +1,118 @@
+// crc32c.hpp : CRC-32C checksum
+
+#ifndef crc32c_hpp__
+#define crc32c_hpp__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#  include <nmmintrin.h>
+#  define CRC32C_HW_GNUC 1
+#elif defined(_MSC_VER) && defined(_M_X64)
+#  include <nmmintrin.h>
+#  include <intrin.h>
+#  define CRC32C_HW_MSVC 1
+#endif
+
+// CRC-32C (Castagnoli, reflected polynomial 0x82f63b78). Hosts with SSE4.2 use the crc32 instruction; the
+// choice is made once, at the first call. Everywhere else the checksum is computed with slicing-by-8 tables.
+static const uint32_t DEFAULT_CRC32C_SEED = 0;
+
+struct crc32c_slice_tables
+{
+    crc32c_slice_tables() {
+        for (uint32_t x = 0; x < 256; ++x) {
+            uint32_t c = x;
+            for (int b = 0; b < 8; ++b) {
+                c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+            }
+            t[0][x] = c;
+        }
+        for (unsigned k = 1; k < 8; ++k) {
+            for (unsigned x = 0; x < 256; ++x) {
+                t[k][x] = (t[k-1][x] >> 8) ^ t[0][t[k-1][x] & 0xff];
+            }
+        }
+    }
+
+    uint32_t t[8][256];
+};
+
+inline const crc32c_slice_tables &crc32c_slices()
+{
+    static const crc32c_slice_tables tables;
+    return tables;
+}
+
+inline uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *p, size_t n)
+{
+    const crc32c_slice_tables &s = crc32c_slices();
+    while (n >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        uint32_t hi = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+        crc = s.t[7][lo & 0xff] ^ s.t[6][(lo >> 8) & 0xff] ^ s.t[5][(lo >> 16) & 0xff] ^ s.t[4][lo >> 24] ^
+              s.t[3][hi & 0xff] ^ s.t[2][(hi >> 8) & 0xff] ^ s.t[1][(hi >> 16) & 0xff] ^ s.t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) {
+        crc = (crc >> 8) ^ s.t[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(CRC32C_HW_GNUC) || defined(CRC32C_HW_MSVC)
+
+#if defined(CRC32C_HW_GNUC)
+__attribute__((target("sse4.2")))
+#endif
+inline uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t n)
+{
+    uint64_t c = crc;
+    while (n >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        n -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (n--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return c32;
+}
+
+inline bool crc32c_hw_supported()
+{
+#if defined(CRC32C_HW_GNUC)
+    return __builtin_cpu_supports("sse4.2") != 0;
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#endif
+}
+
+#endif
+
+typedef uint32_t (*crc32c_update_fcn)(uint32_t crc, const uint8_t *p, size_t n);
+
+inline crc32c_update_fcn crc32c_select()
+{
+#if defined(CRC32C_HW_GNUC) || defined(CRC32C_HW_MSVC)
+    if (crc32c_hw_supported()) return crc32c_update_hw;
+#endif
+    return crc32c_update_sw;
+}
+
+// seed is the CRC of the preceding data, if any, so that a checksum can be computed piecewise.
+inline uint32_t crc32c(const uint8_t *it, const uint8_t *end, uint32_t seed = DEFAULT_CRC32C_SEED)
+{
+    static const crc32c_update_fcn update = crc32c_select();
+    return ~update(~seed, it, (size_t)(end - it));
+}
+
+#endif
@@ -46,4 +46,51 @@ uint8_t crc8(Iterator it, Iterator end, uint8_t seed = DEFAULT_CRC8_SEED)
     return (uint8_t)(crc ^ 0xff);
 }
 
+// crc8_slices().t[k][x] is the CRC register after byte x followed by k zero bytes, so eight bytes can be folded
+// into the register with eight independent table lookups instead of eight dependent ones.
+struct crc8_slice_tables
+{
+    crc8_slice_tables() {
+        for (unsigned x = 0; x < 256; ++x) {
+            t[0][x] = crc8_table[x];
+        }
+        for (unsigned k = 1; k < 8; ++k) {
+            for (unsigned x = 0; x < 256; ++x) {
+                t[k][x] = crc8_table[t[k-1][x]];
+            }
+        }
+    }
+
+    uint8_t t[8][256];
+};
+
+inline const crc8_slice_tables &crc8_slices()
+{
+    static const crc8_slice_tables tables;
+    return tables;
+}
+
+inline uint8_t crc8(const uint8_t *it, const uint8_t *end, uint8_t seed = DEFAULT_CRC8_SEED)
+{
+    unsigned crc = seed ^ 0xff;
+    if (end - it >= 8) {
+        const crc8_slice_tables &s = crc8_slices();
+        do {
+            crc = s.t[7][crc ^ it[0]] ^ s.t[6][it[1]] ^ s.t[5][it[2]] ^ s.t[4][it[3]] ^
+                  s.t[3][it[4]] ^ s.t[2][it[5]] ^ s.t[1][it[6]] ^ s.t[0][it[7]];
+            it += 8;
+        } while (end - it >= 8);
+    }
+    while (it != end) {
+        crc = crc8_table[crc ^ *it];
+        ++it;
+    }
+    return (uint8_t)(crc ^ 0xff);
+}
+
+inline uint8_t crc8(uint8_t *it, uint8_t *end, uint8_t seed = DEFAULT_CRC8_SEED)
+{
+    return crc8(const_cast<const uint8_t*>(it), const_cast<const uint8_t*>(end), seed);
+}
+
 #endif
\ No newline at end of file
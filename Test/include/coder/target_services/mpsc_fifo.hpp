@@ -0,0 +1,91 @@
+// mpsc_fifo.hpp : multi-producer single-consumer fifo
+
+#ifndef coder_tgtsvc_detail_mpsc_fifo_hpp
+#define coder_tgtsvc_detail_mpsc_fifo_hpp
+
+#include <stddef.h>
+#include <atomic>
+
+namespace coder { namespace tgtsvc { namespace detail {
+
+#ifndef CODER_TGTSVC_CACHE_LINE_SIZE
+#define CODER_TGTSVC_CACHE_LINE_SIZE 64
+#endif
+
+// Bounded multi-producer/single-consumer ring. Producers claim a slot by advancing the shared enqueue index
+// with a compare-and-swap; every slot carries a sequence number that tells producers whether it has been
+// consumed and tells the consumer whether it has been filled, so no lock is taken on either side.
+template<typename T, size_t N>
+class mpsc_fifo
+{
+public:
+
+    typedef T value_type;
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "mpsc_fifo size must be a power of two");
+
+    mpsc_fifo() : dequeue_(0) {
+        for (size_t i = 0; i < N; ++i) {
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+        enqueue_.store(0, std::memory_order_relaxed);
+    }
+
+    static size_t capacity() { return N; }
+
+    // Any thread.
+    bool push(const T &val) {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        cell *c;
+        for (;;) {
+            c = &cells_[pos & MASK];
+            size_t seq = c->sequence_.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (dif == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (dif < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+        c->value_ = val;
+        c->sequence_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    bool empty() const {
+        return cells_[dequeue_ & MASK].sequence_.load(std::memory_order_acquire) != dequeue_ + 1;
+    }
+
+    bool pop(T &val) {
+        cell &c = cells_[dequeue_ & MASK];
+        if (c.sequence_.load(std::memory_order_acquire) != dequeue_ + 1) return false;
+        val = c.value_;
+        c.sequence_.store(dequeue_ + N, std::memory_order_release);
+        ++dequeue_;
+        return true;
+    }
+
+private:
+    enum { MASK = N - 1 };
+
+    struct cell {
+        std::atomic<size_t> sequence_;
+        T value_;
+    };
+
+    alignas(CODER_TGTSVC_CACHE_LINE_SIZE) std::atomic<size_t> enqueue_;
+    alignas(CODER_TGTSVC_CACHE_LINE_SIZE) size_t dequeue_;
+    alignas(CODER_TGTSVC_CACHE_LINE_SIZE) cell cells_[N];
+
+    mpsc_fifo(const mpsc_fifo &);
+    mpsc_fifo &operator=(const mpsc_fifo &);
+};
+
+}}}
+
+#endif
@@ -0,0 +1,164 @@
+// spsc_fifo.hpp : single-producer single-consumer fifo
+
+#ifndef coder_tgtsvc_detail_spsc_fifo_hpp
+#define coder_tgtsvc_detail_spsc_fifo_hpp
+
+#include <stddef.h>
+#include <atomic>
+#include <algorithm>
+
+namespace coder { namespace tgtsvc { namespace detail {
+
+#ifndef CODER_TGTSVC_CACHE_LINE_SIZE
+#define CODER_TGTSVC_CACHE_LINE_SIZE 64
+#endif
+
+// Single-producer/single-consumer ring. Unlike fifo, the indices are std::atomic and published with
+// release/acquire ordering, so one thread may push while another pops on a multi-core host. Each side keeps a
+// cached copy of the other side's index and only reloads it when the ring looks full or empty. The atomic
+// stores make a single push or pop dearer than fifo's, so a queue used from one thread only is better left as
+// fifo, and the batch forms below should be preferred where several elements move at once.
+template<typename T, size_t N>
+class spsc_fifo
+{
+public:
+
+    typedef T value_type;
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "spsc_fifo size must be a power of two");
+
+    spsc_fifo() {
+        producer_.tail_.store(0, std::memory_order_relaxed);
+        producer_.head_ = 0;
+        consumer_.head_.store(0, std::memory_order_relaxed);
+        consumer_.tail_ = 0;
+    }
+
+    static size_t capacity() { return N; }
+
+    // Either side may call these; the result is a snapshot.
+    bool empty() const { return contents_size() == 0; }
+    bool full() const { return contents_size() == N; }
+    size_t contents_size() const {
+        size_t head = consumer_.head_.load(std::memory_order_acquire);
+        size_t tail = producer_.tail_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    // Producer side.
+    size_t space() {
+        size_t tail = producer_.tail_.load(std::memory_order_relaxed);
+        producer_.head_ = consumer_.head_.load(std::memory_order_acquire);
+        return N - (tail - producer_.head_);
+    }
+
+    bool push(const T &val) {
+        size_t tail = producer_.tail_.load(std::memory_order_relaxed);
+        if (tail - producer_.head_ == N) {
+            producer_.head_ = consumer_.head_.load(std::memory_order_acquire);
+            if (tail - producer_.head_ == N) return false;
+        }
+        buff_[tail & MASK] = val;
+        producer_.tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t push(const T *vals, size_t count) {
+        size_t tail = producer_.tail_.load(std::memory_order_relaxed);
+        if (N - (tail - producer_.head_) < count) {
+            producer_.head_ = consumer_.head_.load(std::memory_order_acquire);
+        }
+        count = std::min(count, N - (tail - producer_.head_));
+        if (count == 0) return 0;
+
+        size_t first = std::min(count, N - (tail & MASK));
+        std::copy(vals, vals + first, buff_ + (tail & MASK));
+        std::copy(vals + first, vals + count, buff_);
+        producer_.tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side.
+    T &front() {
+        return buff_[consumer_.head_.load(std::memory_order_relaxed) & MASK];
+    }
+
+    void pop() {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        if (head == consumer_.tail_) {
+            consumer_.tail_ = producer_.tail_.load(std::memory_order_acquire);
+        }
+        consumer_.head_.store(head + 1, std::memory_order_release);
+    }
+
+    bool pop(T &val) {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        if (head == consumer_.tail_) {
+            consumer_.tail_ = producer_.tail_.load(std::memory_order_acquire);
+            if (head == consumer_.tail_) return false;
+        }
+        val = buff_[head & MASK];
+        consumer_.head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t pop(T *vals, size_t count) {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        if (consumer_.tail_ - head < count) {
+            consumer_.tail_ = producer_.tail_.load(std::memory_order_acquire);
+        }
+        count = std::min(count, consumer_.tail_ - head);
+        if (count == 0) return 0;
+
+        size_t first = std::min(count, N - (head & MASK));
+        std::copy(buff_ + (head & MASK), buff_ + (head & MASK) + first, vals);
+        std::copy(buff_, buff_ + (count - first), vals + first);
+        consumer_.head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side: the contiguous run of elements at the head, left in place until contents_remove()
+    struct carray {
+        const T *addr_;
+        size_t size_;
+    };
+
+    carray contents_carray() {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        consumer_.tail_ = producer_.tail_.load(std::memory_order_acquire);
+        carray r;
+        r.addr_ = buff_ + (head & MASK);
+        r.size_ = std::min(consumer_.tail_ - head, N - (head & MASK));
+        return r;
+    }
+
+    void contents_remove(size_t count) {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        consumer_.head_.store(head + count, std::memory_order_release);
+    }
+
+private:
+    enum { MASK = N - 1 };
+
+    // tail_ is written by the producer only, head_ by the consumer only; each is kept on its own cache line
+    // together with the owner's cached copy of the other index.
+    struct alignas(CODER_TGTSVC_CACHE_LINE_SIZE) producer_side {
+        std::atomic<size_t> tail_;
+        size_t head_;
+    };
+    struct alignas(CODER_TGTSVC_CACHE_LINE_SIZE) consumer_side {
+        std::atomic<size_t> head_;
+        size_t tail_;
+    };
+
+    producer_side producer_;
+    consumer_side consumer_;
+    alignas(CODER_TGTSVC_CACHE_LINE_SIZE) T buff_[N];
+
+    spsc_fifo(const spsc_fifo &);
+    spsc_fifo &operator=(const spsc_fifo &);
+};
+
+}}}
+
+#endif
@@ -0,0 +1,195 @@
+// BusHierarchy.hpp : bus hierarchy compilation for the local queue engine
+
+#ifndef BUS_HIERARCHY_HPP
+#define BUS_HIERARCHY_HPP
+
+/*
+ * Bus layouts built with sdiCreateBusHierDefinition and sdiAddBusHierLeaf, and their compilation into a copy
+ * program for LocalAsyncioQueue.hpp. Compiling walks the hierarchy once and lists the bytes of every leaf
+ * instance in the order of the packed record: the leaves one after the other, each with the instances from all
+ * enclosing arrays of buses back to back. Adjacent source runs are merged into single copies and equally spaced
+ * runs of equal size into strided gathers, so writing a bus sample runs a few copies, with no tree walk.
+ *
+ * Leaf byte offsets are taken from the start of the top-level bus, for the first element of every enclosing
+ * array of buses; element k of an array of buses lies k times its busTypeBytes further on.
+ */
+
+#include "AsyncioQueueCAPI.h"
+#include "SignalThinning.hpp"
+
+#include <string.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sdilocal {
+
+inline size_t numberOfElements(const std::vector<int> &dims)
+{
+    size_t n = 1;
+    for (size_t i = 0; i < dims.size(); ++i) n *= dims[i];
+    return n;
+}
+
+inline std::vector<int> toVector(const sdiDims *dims)
+{
+    std::vector<int> v;
+    if (dims != NULL) v.assign(dims->dimensions, dims->dimensions + dims->nDims);
+    return v;
+}
+
+struct BusNode {
+    struct Element {
+        /* Set for a nested bus; otherwise the element is a leaf */
+        std::unique_ptr<BusNode> bus_;
+
+        std::string name_;
+        int byteOffset_;
+        const DataType *type_;
+        sdiComplexity complexity_;
+        std::vector<int> dims_;
+        sdiSampleTimeContinuity continuity_;
+    };
+
+    BusNode(const std::string &name, const sdiDims *dims, int busTypeBytes) :
+        name_(name), dims_(toVector(dims)), busTypeBytes_(busTypeBytes) {}
+
+    std::string name_;
+    std::vector<int> dims_;
+    int busTypeBytes_;
+    std::vector<Element> elements_;
+};
+
+/* A leaf of a compiled bus: where its instances sit in the packed record, and how to store them */
+struct BusColumn {
+    std::string name_;
+    const DataType *type_;
+    sdiComplexity complexity_;
+    sdiSampleTimeContinuity continuity_;
+    std::vector<int> dims_;
+    size_t offset_;
+    size_t bytes_;
+};
+
+class CopyProgram
+{
+  public:
+    CopyProgram() : recordBytes_(0) {}
+
+    /* Appends len bytes at src to the record */
+    void add(size_t src, size_t len)
+    {
+        recordBytes_ += len;
+        if (!ops_.empty()) {
+            Op &op = ops_.back();
+            if (op.count_ == 1 && op.src_ + op.len_ == src) {
+                op.len_ += len;
+                return;
+            }
+            if (op.len_ == len && (op.count_ == 1 || src == op.src_ + op.count_ * op.stride_)) {
+                if (op.count_ == 1) op.stride_ = (ptrdiff_t)(src - op.src_);
+                ++op.count_;
+                return;
+            }
+        }
+        Op op = { src, len, 1, 0 };
+        ops_.push_back(op);
+    }
+
+    void run(unsigned char *dst, const unsigned char *src) const
+    {
+        for (size_t i = 0; i < ops_.size(); ++i) {
+            const Op &op = ops_[i];
+            if (op.count_ == 1) {
+                memcpy(dst, src + op.src_, op.len_);
+                dst += op.len_;
+                continue;
+            }
+            switch (op.len_) {
+              case 1:  dst = gather<1>(dst, src + op.src_, op.count_, op.stride_); break;
+              case 2:  dst = gather<2>(dst, src + op.src_, op.count_, op.stride_); break;
+              case 4:  dst = gather<4>(dst, src + op.src_, op.count_, op.stride_); break;
+              case 8:  dst = gather<8>(dst, src + op.src_, op.count_, op.stride_); break;
+              case 16: dst = gather<16>(dst, src + op.src_, op.count_, op.stride_); break;
+              default:
+                for (size_t k = 0; k < op.count_; ++k, dst += op.len_) {
+                    memcpy(dst, src + op.src_ + (ptrdiff_t)k * op.stride_, op.len_);
+                }
+                break;
+            }
+        }
+    }
+
+    size_t recordBytes() const { return recordBytes_; }
+    size_t copies() const { return ops_.size(); }
+
+  private:
+    struct Op {
+        size_t src_;
+        size_t len_;
+        size_t count_;
+        ptrdiff_t stride_;
+    };
+
+    std::vector<Op> ops_;
+    size_t recordBytes_;
+
+    /* A fixed size lets the compiler turn each copy into a single load and store */
+    template <size_t LEN>
+    static unsigned char *gather(unsigned char *dst, const unsigned char *src, size_t count, ptrdiff_t stride)
+    {
+        for (size_t k = 0; k < count; ++k, dst += LEN, src += stride) memcpy(dst, src, LEN);
+        return dst;
+    }
+};
+
+namespace detail {
+
+inline void flattenBus(const BusNode &node, const std::vector<size_t> &bases, const std::string &prefix,
+                       std::vector<BusColumn> &columns, CopyProgram &program)
+{
+    for (size_t i = 0; i < node.elements_.size(); ++i) {
+        const BusNode::Element &e = node.elements_[i];
+        if (e.bus_) {
+            const BusNode &bus = *e.bus_;
+            std::vector<size_t> inner;
+            size_t n = numberOfElements(bus.dims_);
+            for (size_t b = 0; b < bases.size(); ++b) {
+                for (size_t k = 0; k < n; ++k) inner.push_back(bases[b] + k * bus.busTypeBytes_);
+            }
+            flattenBus(bus, inner, prefix + bus.name_ + ".", columns, program);
+            continue;
+        }
+        // Leaves of types the local engine does not know are not logged
+        if (e.type_ == NULL) continue;
+        size_t bytes = numberOfElements(e.dims_) * e.type_->size * (e.complexity_ == COMPLEX ? 2 : 1);
+        BusColumn c;
+        c.name_ = prefix + e.name_;
+        c.type_ = e.type_;
+        c.complexity_ = e.complexity_;
+        c.continuity_ = e.continuity_;
+        c.dims_ = e.dims_;
+        if (bases.size() > 1) c.dims_.insert(c.dims_.begin(), (int)bases.size());
+        c.offset_ = program.recordBytes();
+        c.bytes_ = bytes * bases.size();
+        for (size_t b = 0; b < bases.size(); ++b) program.add(bases[b] + e.byteOffset_, bytes);
+        columns.push_back(c);
+    }
+}
+
+}
+
+/* Compiles the bus logged as an array of dims elements of busSize bytes */
+inline void compileBus(const BusNode &root, int busSize, const std::vector<int> &dims,
+                       std::vector<BusColumn> &columns, CopyProgram &program)
+{
+    std::vector<size_t> bases;
+    size_t n = numberOfElements(dims);
+    for (size_t k = 0; k < n; ++k) bases.push_back(k * busSize);
+    detail::flattenBus(root, bases, root.name_.empty() ? std::string() : root.name_ + ".", columns, program);
+}
+
+} /* namespace sdilocal */
+
+#endif
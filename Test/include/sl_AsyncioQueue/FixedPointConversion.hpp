@@ -0,0 +1,179 @@
+// FixedPointConversion.hpp : fixed-point to floating-point conversion
+
+#ifndef FIXED_POINT_CONVERSION_HPP
+#define FIXED_POINT_CONVERSION_HPP
+
+/*
+ * Bulk conversion of logged fixed-point data to real-world double or single values, for exporting runs. The
+ * scaling of sdiFxpPropsBinaryPointScaling or sdiFxpPropsSlpBiasScaling is folded into one slope and bias when
+ * the converter is made, and each word length gets a loop over its storage container. These loops do no
+ * per-element branching, so the compiler vectorizes them.
+ *
+ * Stored integers are read as Simulink keeps them: a word of up to 64 bits lies in the smallest 8, 16, 32 or 64
+ * bit container, with the bits above the word length ignored; longer words, up to 128 bits, are multiword
+ * values of 32-bit chunks, least significant first. Words packed back to back without padding, as some targets
+ * send them, are read with convertPacked().
+ */
+
+#include "AsyncioQueueCAPI.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace sdilocal {
+
+class FixedPointConverter
+{
+  public:
+    enum {
+        MAX_WORD_LENGTH = 128,
+        MAX_PACKED_WORD_LENGTH = 64
+    };
+
+    /* Real-world value = stored integer * 2^-fractionLength */
+    explicit FixedPointConverter(const sdiFxpPropsBinaryPointScaling &p) :
+        signed_(p.signedness != 0), wordLength_(p.wordLength), slope_(ldexp(1.0, -p.fractionLength)), bias_(0)
+    {
+        init();
+    }
+
+    /* Real-world value = stored integer * slpAdjustmentFactor * 2^fixedExponent + bias */
+    explicit FixedPointConverter(const sdiFxpPropsSlpBiasScaling &p) :
+        signed_(p.signedness != 0), wordLength_(p.wordLength),
+        slope_(ldexp(p.slpAdjustmentFactor, p.fixedExponent)), bias_(p.bias)
+    {
+        init();
+    }
+
+    /* False for word lengths outside 1 to MAX_WORD_LENGTH, which convert to NaN */
+    bool valid() const { return containerBytes_ != 0; }
+
+    /* Bytes a stored integer takes in a buffer of containers */
+    size_t containerBytes() const { return containerBytes_; }
+
+    void convert(const void *stored, size_t count, double *out) const
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(stored);
+        switch (containerBytes_) {
+          case 1:  signed_ ? scale<int8_t>(p, count, out)  : scale<uint8_t>(p, count, out);  break;
+          case 2:  signed_ ? scale<int16_t>(p, count, out) : scale<uint16_t>(p, count, out); break;
+          case 4:  signed_ ? scale<int32_t>(p, count, out) : scale<uint32_t>(p, count, out); break;
+          case 8:  signed_ ? scale<int64_t>(p, count, out) : scale<uint64_t>(p, count, out); break;
+          case 0:  for (size_t i = 0; i < count; ++i) out[i] = NAN; break;
+          default: scaleMultiword(p, count, out); break;
+        }
+    }
+
+    void convert(const void *stored, size_t count, float *out) const
+    {
+        // Scaled in double, since single cannot hold every stored integer exactly, a block at a time
+        double block[256];
+        const unsigned char *p = static_cast<const unsigned char *>(stored);
+        while (count != 0) {
+            size_t n = count < 256 ? count : 256;
+            convert(p, n, block);
+            for (size_t i = 0; i < n; ++i) out[i] = (float)block[i];
+            p += n * containerBytes_;
+            out += n;
+            count -= n;
+        }
+    }
+
+    /* Words of up to MAX_PACKED_WORD_LENGTH bits back to back, least significant bit first, starting at bit
+     * firstBit of packed */
+    void convertPacked(const void *packed, size_t firstBit, size_t count, double *out) const
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(packed);
+        if (containerBytes_ == 0 || wordLength_ > MAX_PACKED_WORD_LENGTH) {
+            for (size_t i = 0; i < count; ++i) out[i] = NAN;
+            return;
+        }
+        size_t bit = firstBit;
+        for (size_t i = 0; i < count; ++i, bit += wordLength_) {
+            const unsigned char *b = p + bit / 8;
+            unsigned shift = bit % 8;
+            // A word of up to 64 bits spans at most 9 bytes; read only the bytes it covers
+            size_t bytes = (shift + wordLength_ + 7) / 8;
+            uint64_t lo = 0;
+            for (size_t k = 0; k < bytes && k < 8; ++k) lo |= (uint64_t)b[k] << (8 * k);
+            uint64_t v = lo >> shift;
+            if (bytes == 9) v |= (uint64_t)b[8] << (64 - shift);
+            out[i] = value(v);
+        }
+    }
+
+  private:
+    bool signed_;
+    int wordLength_;
+    double slope_;
+    double bias_;
+    size_t containerBytes_;
+    unsigned unused_;
+
+    void init()
+    {
+        if (wordLength_ < 1 || wordLength_ > MAX_WORD_LENGTH) containerBytes_ = 0;
+        else if (wordLength_ <= 8) containerBytes_ = 1;
+        else if (wordLength_ <= 16) containerBytes_ = 2;
+        else if (wordLength_ <= 32) containerBytes_ = 4;
+        else if (wordLength_ <= 64) containerBytes_ = 8;
+        else containerBytes_ = 4 * ((wordLength_ + 31) / 32);
+        unused_ = containerBytes_ <= 8 ? (unsigned)(8 * containerBytes_ - wordLength_) : 0;
+    }
+
+    /* Sign or zero extends the low wordLength_ bits of a container; the shifts compile to vector shifts */
+    template <typename T>
+    void scale(const unsigned char *p, size_t count, double *out) const
+    {
+        typedef typename std::make_unsigned<T>::type U;
+        const unsigned u = unused_;
+        if (bias_ == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                U v;
+                memcpy(&v, p + i * sizeof(U), sizeof(U));
+                out[i] = (double)(T)((T)(U)(v << u) >> u) * slope_;
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                U v;
+                memcpy(&v, p + i * sizeof(U), sizeof(U));
+                out[i] = (double)(T)((T)(U)(v << u) >> u) * slope_ + bias_;
+            }
+        }
+    }
+
+    void scaleMultiword(const unsigned char *p, size_t count, double *out) const
+    {
+        size_t chunks = containerBytes_ / 4;
+        unsigned topUnused = (unsigned)(32 * chunks - wordLength_);
+        for (size_t i = 0; i < count; ++i, p += containerBytes_) {
+            double v = 0;
+            // Horner's rule over the chunks, most significant first
+            for (size_t k = chunks; k-- != 0; ) {
+                uint32_t c;
+                memcpy(&c, p + 4 * k, sizeof(c));
+                if (k == chunks - 1) {
+                    c = (uint32_t)(c << topUnused);
+                    v = signed_ ? (double)((int32_t)c >> topUnused) : (double)(c >> topUnused);
+                } else {
+                    v = v * 4294967296.0 + c;
+                }
+            }
+            out[i] = v * slope_ + bias_;
+        }
+    }
+
+    double value(uint64_t bits) const
+    {
+        unsigned u = (unsigned)(64 - wordLength_);
+        double v = signed_ ? (double)((int64_t)(bits << u) >> u) : (double)((bits << u) >> u);
+        return v * slope_ + bias_;
+    }
+};
+
+} /* namespace sdilocal */
+
+#endif
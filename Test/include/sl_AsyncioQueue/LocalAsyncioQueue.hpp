@@ -0,0 +1,652 @@
+// LocalAsyncioQueue.hpp : local queue engine behind AsyncioQueueCAPI.h
+
+#ifndef LOCAL_ASYNCIO_QUEUE_HPP
+#define LOCAL_ASYNCIO_QUEUE_HPP
+
+/*
+ * Local stand-in for the queue engine behind AsyncioQueueCAPI.h, for running and profiling signal logging
+ * without the Simulink Data Inspector repository. Every signal gets a lock-free single-producer/single-consumer
+ * ring with separate time and sample columns; a background thread drains the rings into one time file and one
+ * data file per signal plus a catalog, in the directory named by SDI_LOCAL_LOG_DIR (default: current
+ * directory).
+ *
+ * Define SDI_LOCAL_ASYNCIO_QUEUE_IMPLEMENTATION in exactly one translation unit, and do not link the real
+ * library, to get the C entry points of the subset used for plain signal logging: sdiInitializeRepository,
+ * sdiAsyncRepoGetBuiltInDataTypeHandle, sdiGetDataSizeInBytes, sdiAsyncRepoCreateAsyncioQueue,
+ * sdiIsAsyncQueueDisabled, sdiWriteSignal, sdiDisableDataThinning, sdiAsyncRepoSetSignalExportSettings,
+ * sdiSynchronouslyFlushAllQueuesInThisModel(U) and sdiTerminateStreaming; and for nonvirtual buses
+ * sdiCreateBusHierDefinition, sdiAddBusHierLeaf and sdiCreateAsyncQueueForNVBus, compiled as described in
+ * BusHierarchy.hpp.
+ *
+ * Samples pass through the thinning of SignalThinning.hpp on their way to disk; continuous signals are thinned
+ * as linearly interpolated, discrete ones as held.
+ */
+
+#include "AsyncioQueueCAPI.h"
+#include "BusHierarchy.hpp"
+#include "SignalThinning.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* Dead-band of thinning, relative to the range of each element; the SDI_LOCAL_THINNING_TOLERANCE environment
+ * variable overrides it at run time and a negative value stores every sample */
+#ifndef SDI_LOCAL_THINNING_TOLERANCE
+#define SDI_LOCAL_THINNING_TOLERANCE 1e-3
+#endif
+
+namespace sdilocal {
+
+/* fopen and getenv without the MSVC deprecation warning C4996 */
+inline FILE *openFile(const std::string &path, const char *mode)
+{
+#ifdef _MSC_VER
+    FILE *f = NULL;
+    return fopen_s(&f, path.c_str(), mode) == 0 ? f : NULL;
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+inline std::string environment(const char *name)
+{
+#ifdef _MSC_VER
+    char *value = NULL;
+    size_t size = 0;
+    std::string r;
+    if (_dupenv_s(&value, &size, name) == 0 && value != NULL) r = value;
+    free(value);
+    return r;
+#else
+    const char *value = getenv(name);
+    return value != NULL ? std::string(value) : std::string();
+#endif
+}
+
+/* One logged signal. write() is called by the model thread only, drain() by the engine thread only. A bus is
+ * queued as packed records gathered by its copy program and stored as one pair of column files per leaf. */
+class SignalQueue
+{
+  public:
+    SignalQueue(size_t index, const DataType *type, sdiComplexity complexity, const sdiDims *dims,
+                sdiSampleTimeContinuity continuity, const std::string &name) :
+        index_(index), name_(name), bus_(false), logged_(0), stalls_(0)
+    {
+        BusColumn c;
+        c.type_ = type;
+        c.complexity_ = complexity;
+        c.continuity_ = continuity;
+        c.dims_ = toVector(dims);
+        c.offset_ = 0;
+        c.bytes_ = numberOfElements(c.dims_) * type->size * (complexity == COMPLEX ? 2 : 1);
+        columns_.push_back(std::unique_ptr<Column>(new Column(c)));
+        init(c.bytes_);
+    }
+
+    SignalQueue(size_t index, const std::vector<BusColumn> &columns, const CopyProgram &program,
+                const std::string &name) :
+        index_(index), name_(name), bus_(true), program_(program), logged_(0), stalls_(0)
+    {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            columns_.push_back(std::unique_ptr<Column>(new Column(columns[i])));
+        }
+        init(program.recordBytes());
+    }
+
+    bool write(double time, const void *data)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == capacity_) return false;
+        size_t slot = tail & (capacity_ - 1);
+        times_[slot] = time;
+        if (bus_) {
+            program_.run(&samples_[slot * recordBytes_], static_cast<const unsigned char *>(data));
+        } else {
+            memcpy(&samples_[slot * recordBytes_], data, recordBytes_);
+        }
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Appends every queued record that survives thinning to the column files; returns the number of records
+     * taken from the ring. A negative tolerance stores every record. */
+    size_t drain(const std::string &dir, double tolerance)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) return 0;
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            Column &c = *columns_[i];
+            if (!open(dir, i)) continue;
+            c.thinner_->configure(thinning_.load(std::memory_order_relaxed) ? tolerance : -1,
+                                  decimation_.load(std::memory_order_relaxed), c.out_);
+            if (!c.thinner_->active() && c.spec_.bytes_ == recordBytes_) {
+                c.store();
+                for (size_t h = head; h != tail; ) {
+                    size_t slot = h & (capacity_ - 1);
+                    size_t run = tail - h < capacity_ - slot ? tail - h : capacity_ - slot;
+                    fwrite(&times_[slot], sizeof(double), run, c.timeFile_);
+                    fwrite(&samples_[slot * recordBytes_], recordBytes_, run, c.dataFile_);
+                    h += run;
+                    c.written_ += run;
+                }
+                continue;
+            }
+            for (size_t h = head; h != tail; ++h) {
+                size_t slot = h & (capacity_ - 1);
+                const unsigned char *sample = &samples_[slot * recordBytes_ + c.spec_.offset_];
+                if (c.thinner_->active()) c.thinner_->push(times_[slot], sample, c.out_);
+                else c.out_(times_[slot], sample);
+            }
+            c.store();
+        }
+        head_.store(tail, std::memory_order_release);
+        logged_ += tail - head;
+        return tail - head;
+    }
+
+    /* Stores the last sample held back by thinning as well */
+    void flush()
+    {
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            Column &c = *columns_[i];
+            c.thinner_->flush(c.out_);
+            c.store();
+            if (c.timeFile_ != NULL) fflush(c.timeFile_);
+            if (c.dataFile_ != NULL) fflush(c.dataFile_);
+        }
+    }
+
+    /* Stores what is left and closes the column files; nothing more is logged to them */
+    void close()
+    {
+        flush();
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            Column &c = *columns_[i];
+            if (c.timeFile_ != NULL) fclose(c.timeFile_);
+            if (c.dataFile_ != NULL) fclose(c.dataFile_);
+            c.timeFile_ = c.dataFile_ = NULL;
+        }
+        closed_ = true;
+    }
+
+    /* One line per column, numbered index.column for a bus */
+    void catalog(FILE *f) const
+    {
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            const BusColumn &s = columns_[i]->spec_;
+            if (bus_) fprintf(f, "%lu.%lu\t%s.%s\t", (unsigned long)index_, (unsigned long)i, name_.c_str(),
+                              s.name_.c_str());
+            else fprintf(f, "%lu\t%s\t", (unsigned long)index_, name_.c_str());
+            fprintf(f, "%s\t%s\t", s.type_->name, s.complexity_ == COMPLEX ? "complex" : "real");
+            for (size_t d = 0; d < s.dims_.size(); ++d) fprintf(f, d == 0 ? "%d" : "x%d", s.dims_[d]);
+            fprintf(f, "\t%llu\t%llu\t%llu\n", (unsigned long long)logged_,
+                    (unsigned long long)columns_[i]->written_,
+                    (unsigned long long)stalls_.load(std::memory_order_relaxed));
+        }
+    }
+
+    void stalled() { stalls_.fetch_add(1, std::memory_order_relaxed); }
+
+    std::atomic<bool> disabled_;
+    std::atomic<bool> thinning_;
+    std::atomic<int> decimation_;
+
+  private:
+    /* Records kept by the thinner since the last store() */
+    struct Output {
+        size_t sampleBytes_;
+        std::vector<double> times_;
+        std::vector<unsigned char> samples_;
+
+        void operator()(double time, const unsigned char *sample)
+        {
+            times_.push_back(time);
+            samples_.insert(samples_.end(), sample, sample + sampleBytes_);
+        }
+    };
+
+    struct Column {
+        explicit Column(const BusColumn &spec) :
+            spec_(spec), timeFile_(NULL), dataFile_(NULL), written_(0)
+        {
+            thinner_.reset(new SignalThinner(spec.type_->id, spec.bytes_ / spec.type_->size, spec.bytes_,
+                                             spec.continuity_ == SAMPLE_TIME_CONTINUOUS));
+            out_.sampleBytes_ = spec.bytes_;
+        }
+
+        ~Column()
+        {
+            if (timeFile_ != NULL) fclose(timeFile_);
+            if (dataFile_ != NULL) fclose(dataFile_);
+        }
+
+        void store()
+        {
+            if (out_.times_.empty() || timeFile_ == NULL) return;
+            fwrite(&out_.times_[0], sizeof(double), out_.times_.size(), timeFile_);
+            if (spec_.bytes_ != 0) fwrite(&out_.samples_[0], spec_.bytes_, out_.times_.size(), dataFile_);
+            written_ += out_.times_.size();
+            out_.times_.clear();
+            out_.samples_.clear();
+        }
+
+        BusColumn spec_;
+        std::unique_ptr<SignalThinner> thinner_;
+        Output out_;
+        FILE *timeFile_;
+        FILE *dataFile_;
+        uint64_t written_;
+    };
+
+    size_t index_;
+    std::string name_;
+    bool bus_;
+    CopyProgram program_;
+    std::vector<std::unique_ptr<Column> > columns_;
+    size_t recordBytes_;
+    size_t capacity_;
+    std::vector<double> times_;
+    std::vector<unsigned char> samples_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+    uint64_t logged_;
+    std::atomic<uint64_t> stalls_;
+    bool closed_;
+
+    void init(size_t recordBytes)
+    {
+        recordBytes_ = recordBytes;
+        /* About 1 MiB per signal, rounded to a power of two records */
+        size_t want = ((size_t)1 << 20) / (sizeof(double) + recordBytes_ + 1);
+        capacity_ = 64;
+        while (capacity_ < want && capacity_ < ((size_t)1 << 16)) capacity_ <<= 1;
+        times_.resize(capacity_);
+        samples_.resize(capacity_ * recordBytes_);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        closed_ = false;
+        disabled_.store(false, std::memory_order_relaxed);
+        thinning_.store(true, std::memory_order_relaxed);
+        decimation_.store(1, std::memory_order_relaxed);
+    }
+
+    bool open(const std::string &dir, size_t column)
+    {
+        Column &c = *columns_[column];
+        if (c.timeFile_ != NULL) return true;
+        if (closed_) return false;
+        char base[64];
+        if (bus_) snprintf(base, sizeof(base), "/signal%lu_%lu", (unsigned long)index_, (unsigned long)column);
+        else snprintf(base, sizeof(base), "/signal%lu", (unsigned long)index_);
+        c.timeFile_ = openFile(dir + base + ".time", "wb");
+        c.dataFile_ = openFile(dir + base + ".data", "wb");
+        if (c.timeFile_ == NULL || c.dataFile_ == NULL) {
+            if (c.timeFile_ != NULL) fclose(c.timeFile_);
+            if (c.dataFile_ != NULL) fclose(c.dataFile_);
+            c.timeFile_ = c.dataFile_ = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    SignalQueue(const SignalQueue &);
+    SignalQueue &operator=(const SignalQueue &);
+};
+
+class Engine
+{
+  public:
+    static Engine &instance()
+    {
+        static Engine engine;
+        return engine;
+    }
+
+    ~Engine()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        adopt();
+        drainAll();
+        for (size_t i = 0; i < draining_.size(); ++i) draining_[i]->flush();
+        writeCatalog();
+    }
+
+    /* The log directory and tolerance are read when the engine starts and kept for the run */
+    void initialize()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start();
+    }
+
+    SignalQueue *createQueue(const DataType *type, sdiComplexity complexity, const sdiDims *dims,
+                             sdiSampleTimeContinuity continuity, const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start();
+        queues_.push_back(std::unique_ptr<SignalQueue>(
+            new SignalQueue(queues_.size(), type, complexity, dims, continuity, name)));
+        return queues_.back().get();
+    }
+
+    /* The bus is compiled once here; its writes then run the copy program */
+    SignalQueue *createBusQueue(const BusNode &root, int busSize, const sdiDims *dims, const std::string &name)
+    {
+        std::vector<BusColumn> columns;
+        CopyProgram program;
+        compileBus(root, busSize, toVector(dims), columns, program);
+        std::lock_guard<std::mutex> lock(mutex_);
+        start();
+        queues_.push_back(std::unique_ptr<SignalQueue>(new SignalQueue(queues_.size(), columns, program, name)));
+        return queues_.back().get();
+    }
+
+    /* Top-level bus definitions live as long as the engine; nested ones belong to their parent */
+    BusNode *adoptBus(BusNode *root)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buses_.push_back(std::unique_ptr<BusNode>(root));
+        return root;
+    }
+
+    /* A full ring makes the model wait for the drain thread rather than lose samples */
+    void write(SignalQueue *q, double time, const void *data)
+    {
+        if (q->disabled_.load(std::memory_order_relaxed)) return;
+        if (q->write(time, data)) return;
+        q->stalled();
+        do {
+            wake_.notify_one();
+            std::this_thread::yield();
+        } while (!q->write(time, data));
+    }
+
+    /* Returns once everything written before the call is on disk */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) return;
+        uint64_t request = ++flushRequested_;
+        wake_.notify_one();
+        flushed_.wait(lock, [&] { return flushCompleted_ >= request; });
+    }
+
+    /* Called from the model thread, the queue's only writer, so nothing reaches the ring after the flush; the
+     * engine thread then closes the queue's files and writes the catalog with its final counts */
+    void terminate(SignalQueue *q)
+    {
+        q->disabled_.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) return;
+            closing_.push_back(q);
+        }
+        flush();
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<std::unique_ptr<SignalQueue> > queues_;
+    std::vector<std::unique_ptr<BusNode> > buses_;
+    std::vector<SignalQueue *> closing_;
+    std::vector<SignalQueue *> draining_;
+    std::thread thread_;
+    std::string dir_;
+    double tolerance_;
+    bool stop_;
+    uint64_t flushRequested_;
+    uint64_t flushCompleted_;
+
+    Engine() : dir_("."), tolerance_(SDI_LOCAL_THINNING_TOLERANCE), stop_(false), flushRequested_(0), flushCompleted_(0) {}
+
+    /* Called with mutex_ held */
+    void start()
+    {
+        if (thread_.joinable()) return;
+        std::string dir = environment("SDI_LOCAL_LOG_DIR");
+        dir_ = !dir.empty() ? dir : ".";
+        std::string tolerance = environment("SDI_LOCAL_THINNING_TOLERANCE");
+        tolerance_ = !tolerance.empty() ? atof(tolerance.c_str()) : SDI_LOCAL_THINNING_TOLERANCE;
+        thread_ = std::thread(&Engine::run, this);
+    }
+
+    /* The file I/O runs with mutex_ released, so creating a queue or requesting a flush never waits for the
+     * disk; the queues and the flush request are picked up under the lock on each pass */
+    void run()
+    {
+        std::vector<SignalQueue *> closing;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            adopt();
+            uint64_t request = flushRequested_;
+            closing.swap(closing_);
+            lock.unlock();
+            size_t n = drainAll();
+            if (request != flushCompleted_) {
+                drainAll();
+                for (size_t i = 0; i < draining_.size(); ++i) draining_[i]->flush();
+                for (size_t i = 0; i < closing.size(); ++i) closing[i]->close();
+                closing.clear();
+                writeCatalog();
+            }
+            lock.lock();
+            if (request != flushCompleted_) {
+                flushCompleted_ = request;
+                flushed_.notify_all();
+            } else if (n == 0 && !stop_ && flushRequested_ == request) {
+                wake_.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    /* Queues are only ever added, so the engine thread keeps its own list and copies the new ones; called with
+     * mutex_ held or after the thread has stopped */
+    void adopt()
+    {
+        for (size_t i = draining_.size(); i < queues_.size(); ++i) draining_.push_back(queues_[i].get());
+    }
+
+    /* Engine thread only, or after it has stopped; dir_ and tolerance_ do not change while it runs */
+    size_t drainAll()
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < draining_.size(); ++i) n += draining_[i]->drain(dir_, tolerance_);
+        return n;
+    }
+
+    /* One line per signal: index, name, type, complexity, dimensions, samples logged, samples stored, writer
+     * stalls */
+    void writeCatalog()
+    {
+        FILE *f = openFile(dir_ + "/catalog.txt", "w");
+        if (f == NULL) return;
+        for (size_t i = 0; i < draining_.size(); ++i) draining_[i]->catalog(f);
+        fclose(f);
+    }
+
+    Engine(const Engine &);
+    Engine &operator=(const Engine &);
+};
+
+inline std::string narrow(const CHAR16_T *s)
+{
+    std::string r;
+    for (; s != NULL && *s != 0; ++s) r += *s < 0x80 ? (char)*s : '?';
+    return r;
+}
+
+} /* namespace sdilocal */
+
+#ifdef SDI_LOCAL_ASYNCIO_QUEUE_IMPLEMENTATION
+
+void sdiInitializeRepository(void)
+{
+    sdilocal::Engine::instance().initialize();
+}
+
+sdiAsyncRepoDataTypeHandle sdiAsyncRepoGetBuiltInDataTypeHandle(const sdiBuiltInDTypeId dataTypeClassification)
+{
+    return sdilocal::builtInDataType(dataTypeClassification);
+}
+
+int sdiGetDataSizeInBytes(const sdiAsyncRepoDataTypeHandle hDataType)
+{
+    return hDataType != NULL ? static_cast<const sdilocal::DataType *>(hDataType)->size : 0;
+}
+
+sdiAsyncQueueHandle sdiAsyncRepoCreateAsyncioQueue(
+    const sdiAsyncRepoDataTypeHandle hDataType,
+    const sdiSignalSourceInfoU * sigSourceInfo,
+    const char_T *const modelRefPath,
+    const char_T *const sigSourceUUIDstr,
+    const sdiComplexity complexity,
+    const sdiDims * dims,
+    const sdiDimsMode dimsMode,
+    const sdiSampleTimeContinuity sampleTimeContinuity,
+    const char_T *const units)
+{
+    (void)modelRefPath;
+    (void)sigSourceUUIDstr;
+    (void)dimsMode;
+    (void)units;
+    if (hDataType == NULL) return NULL;
+    std::string name = sigSourceInfo != NULL ? sdilocal::narrow(sigSourceInfo->signalName) : std::string();
+    return sdilocal::Engine::instance().createQueue(
+        static_cast<const sdilocal::DataType *>(hDataType), complexity, dims, sampleTimeContinuity, name);
+}
+
+boolean_T sdiIsAsyncQueueDisabled(sdiAsyncQueueHandle hAsyncQueue)
+{
+    return hAsyncQueue == NULL || static_cast<sdilocal::SignalQueue *>(hAsyncQueue)->disabled_.load();
+}
+
+void sdiWriteSignal(sdiAsyncQueueHandle hAsyncQueue, const double time, const void *const data)
+{
+    if (hAsyncQueue == NULL) return;
+    sdilocal::Engine::instance().write(static_cast<sdilocal::SignalQueue *>(hAsyncQueue), time, data);
+}
+
+sdiHierarchyDefinition sdiCreateBusHierDefinition(
+    sdiHierarchyDefinition parentHier,
+    sdiSignalName name,
+    const sdiDims * dims,
+    const int busTypeBytes)
+{
+    sdilocal::BusNode *node = new sdilocal::BusNode(name != NULL ? name : "", dims, busTypeBytes);
+    if (parentHier == NULL) return sdilocal::Engine::instance().adoptBus(node);
+    sdilocal::BusNode::Element e;
+    e.bus_.reset(node);
+    e.byteOffset_ = 0;
+    e.type_ = NULL;
+    e.complexity_ = REAL;
+    e.continuity_ = SAMPLE_TIME_DISCRETE;
+    static_cast<sdilocal::BusNode *>(parentHier)->elements_.push_back(std::move(e));
+    return node;
+}
+
+void sdiAddBusHierLeaf(
+    sdiHierarchyDefinition parentHier,
+    sdiSignalName name,
+    sdiUnitsU units,
+    int byteOffset,
+    const sdiAsyncRepoDataTypeHandle hDT,
+    const sdiComplexity complexity,
+    const sdiDims * dims,
+    const sdiSampleTimeContinuity sampleTimeContinuity)
+{
+    (void)units;
+    if (parentHier == NULL) return;
+    sdilocal::BusNode::Element e;
+    e.name_ = name != NULL ? name : "";
+    e.byteOffset_ = byteOffset;
+    e.type_ = static_cast<const sdilocal::DataType *>(hDT);
+    e.complexity_ = complexity;
+    e.dims_ = sdilocal::toVector(dims);
+    e.continuity_ = sampleTimeContinuity;
+    static_cast<sdilocal::BusNode *>(parentHier)->elements_.push_back(std::move(e));
+}
+
+/* Leaves with types other than the built-in ones are not logged */
+sdiAsyncQueueHandle sdiCreateAsyncQueueForNVBus(
+    sdiHierarchyDefinition * hierarchy,
+    const sdiSignalSourceInfoU * sigSourceInfo,
+    const char_T *const modelRefPath,
+    const char_T *const sigSourceUUIDstr,
+    const int busSize,
+    const sdiDims * dims,
+    const sdiSampleTimeContinuity sampleTimeContinuity,
+    const int decimation,
+    const int maxPoints,
+    sdiSignalName loggedName,
+    sdiSignalName origSignalName,
+    sdiSignalName propName)
+{
+    (void)modelRefPath;
+    (void)sigSourceUUIDstr;
+    (void)sampleTimeContinuity;
+    (void)maxPoints;
+    (void)origSignalName;
+    (void)propName;
+    if (hierarchy == NULL || *hierarchy == NULL) return NULL;
+    std::string name = loggedName != NULL && *loggedName != '\0' ? std::string(loggedName) :
+        sigSourceInfo != NULL ? sdilocal::narrow(sigSourceInfo->signalName) : std::string();
+    sdilocal::SignalQueue *q = sdilocal::Engine::instance().createBusQueue(
+        *static_cast<const sdilocal::BusNode *>(*hierarchy), busSize, dims, name);
+    q->decimation_.store(decimation, std::memory_order_relaxed);
+    return q;
+}
+
+void sdiDisableDataThinning(sdiAsyncQueueHandle hAsyncQueue)
+{
+    if (hAsyncQueue == NULL) return;
+    static_cast<sdilocal::SignalQueue *>(hAsyncQueue)->thinning_.store(false, std::memory_order_relaxed);
+}
+
+/* Bucketed min/max decimation; maxPoints is not supported */
+void sdiAsyncRepoSetSignalExportSettings(sdiAsyncQueueHandle hAsyncQueue, const int decimation, const int maxPoints)
+{
+    (void)maxPoints;
+    if (hAsyncQueue == NULL) return;
+    static_cast<sdilocal::SignalQueue *>(hAsyncQueue)->decimation_.store(decimation, std::memory_order_relaxed);
+}
+
+/* The local engine logs a single model, so every queue is flushed */
+void sdiSynchronouslyFlushAllQueuesInThisModel(sdiModelName modelName)
+{
+    (void)modelName;
+    sdilocal::Engine::instance().flush();
+}
+
+void sdiSynchronouslyFlushAllQueuesInThisModelU(sdiModelNameU modelName)
+{
+    (void)modelName;
+    sdilocal::Engine::instance().flush();
+}
+
+void sdiTerminateStreaming(sdiAsyncQueueHandle * hAsyncQueue)
+{
+    if (hAsyncQueue == NULL || *hAsyncQueue == NULL) return;
+    sdilocal::Engine::instance().terminate(static_cast<sdilocal::SignalQueue *>(*hAsyncQueue));
+}
+
+#endif
+
+#endif
@@ -0,0 +1,309 @@
+// SignalThinning.hpp : streaming thinning of logged samples
+
+#ifndef SIGNAL_THINNING_HPP
+#define SIGNAL_THINNING_HPP
+
+/*
+ * Streaming reduction of logged samples, run by the drain thread of LocalAsyncioQueue.hpp before samples are
+ * stored. Two stages, each optional:
+ *
+ * - Bucketed decimation: of every `decimation` samples, only the first, the last and those holding the minimum
+ *   or maximum of some element are kept, so peaks and glitches survive where keeping every Nth sample loses
+ *   them.
+ * - Dead-band compression: a sample is dropped when the plot through the kept samples stays within the
+ *   tolerance of it. For a linearly interpolated signal this is the swinging door test against the line from
+ *   the last kept sample; for a zero-order hold signal a sample is kept only when some element has moved by more
+ *   than the tolerance. The tolerance is relative to the range each element has covered so far.
+ *
+ * Samples with equal time stamps, which mark discontinuities, are always kept, and the last sample seen is kept
+ * at every flush.
+ *
+ * With both stages on, the dead-band sees only the samples bucketing keeps, so the tolerance bounds the error
+ * against those and not against the logged signal; the samples bucketing drops add their own error, which the
+ * tolerance does not limit. At a tolerance of 1e-3, linearly interpolated, the largest error relative to the
+ * range was:
+ *
+ *   signal, i = 0, 1, 2, ...                                  decimation  stored      largest error
+ *   sin(2*pi*i/73), 1e5 samples                                        1    1 in 1.3    9.8e-4
+ *   sin(2*pi*i/73), 1e5 samples                                       10    1 in 4.7    3.4e-2
+ *   sin(pi*t) + 0.5*sin(6*pi*t), t = i*1e-4, 1e6 samples               1    1 in 153    1.0e-3
+ *   sin(pi*t) + 0.5*sin(6*pi*t), t = i*1e-4, 1e6 samples              10    1 in 145    1.0e-3
+ *
+ * A fast signal barely compresses within the tolerance, and bucketing it trades accuracy for size.
+ */
+
+#include "AsyncioQueueCAPI.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <limits>
+#include <vector>
+
+namespace sdilocal {
+
+struct DataType {
+    sdiBuiltInDTypeId id;
+    int size;
+    const char *name;
+};
+
+inline const DataType *builtInDataType(sdiBuiltInDTypeId id)
+{
+    static const DataType types[] = {
+        { DATA_TYPE_DOUBLE,  8, "double"  },
+        { DATA_TYPE_SINGLE,  4, "single"  },
+        { DATA_TYPE_INT8,    1, "int8"    },
+        { DATA_TYPE_UINT8,   1, "uint8"   },
+        { DATA_TYPE_INT16,   2, "int16"   },
+        { DATA_TYPE_UINT16,  2, "uint16"  },
+        { DATA_TYPE_INT32,   4, "int32"   },
+        { DATA_TYPE_UINT32,  4, "uint32"  },
+        { DATA_TYPE_BOOLEAN, 1, "boolean" }
+    };
+    return (unsigned)id < sizeof(types)/sizeof(types[0]) ? &types[id] : NULL;
+}
+
+inline double elementAsDouble(sdiBuiltInDTypeId type, const unsigned char *sample, size_t i)
+{
+    switch (type) {
+      case DATA_TYPE_DOUBLE:  { double v;   memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_SINGLE:  { float v;    memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_INT8:    return (int8_t)sample[i];
+      case DATA_TYPE_UINT8:   return sample[i];
+      case DATA_TYPE_INT16:   { int16_t v;  memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_UINT16:  { uint16_t v; memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_INT32:   { int32_t v;  memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_UINT32:  { uint32_t v; memcpy(&v, sample + i*sizeof(v), sizeof(v)); return v; }
+      case DATA_TYPE_BOOLEAN: return sample[i] != 0;
+      default:                return 0;
+    }
+}
+
+/* Sink is called as sink(time, sample) for every sample kept, in time order */
+class SignalThinner
+{
+  public:
+    SignalThinner(sdiBuiltInDTypeId type, size_t elements, size_t sampleBytes, bool linearInterp) :
+        type_(type), elements_(elements), sampleBytes_(sampleBytes), linear_(linearInterp),
+        tolerance_(-1), decimation_(1), bucketCount_(0), hasAnchor_(false), hasHeld_(false),
+        received_(0), kept_(0),
+        values_(elements), bucketTimes_(), bucketSamples_(), bucketMin_(elements), bucketMax_(elements),
+        bucketKeep_(), rangeMin_(elements), rangeMax_(elements), anchor_(elements), slopeLo_(elements),
+        slopeHi_(elements), held_(elements), heldSample_(sampleBytes), heldTime_(0), anchorTime_(0)
+    {
+        for (size_t e = 0; e < elements_; ++e) {
+            rangeMin_[e] = std::numeric_limits<double>::infinity();
+            rangeMax_[e] = -std::numeric_limits<double>::infinity();
+        }
+    }
+
+    /* A negative tolerance disables dead-band compression; a decimation of 1 disables bucketing */
+    template <typename Sink>
+    void configure(double tolerance, int decimation, Sink &sink)
+    {
+        if (decimation < 1) decimation = 1;
+        if (tolerance == tolerance_ && (size_t)decimation == decimation_) return;
+        flush(sink);
+        tolerance_ = tolerance;
+        decimation_ = (size_t)decimation;
+        bucketTimes_.resize(decimation_ > 1 ? decimation_ : 0);
+        bucketSamples_.resize(decimation_ > 1 ? decimation_ * sampleBytes_ : 0);
+        bucketKeep_.resize(decimation_ > 1 ? decimation_ : 0);
+    }
+
+    bool active() const { return tolerance_ >= 0 || decimation_ > 1; }
+
+    template <typename Sink>
+    void push(double time, const unsigned char *sample, Sink &sink)
+    {
+        ++received_;
+        if (decimation_ > 1) bucket(time, sample, sink);
+        else deadband(time, sample, sink);
+    }
+
+    template <typename Sink>
+    void flush(Sink &sink)
+    {
+        emitBucket(sink);
+        if (hasHeld_) {
+            emit(heldTime_, &heldSample_[0], sink);
+            reanchor(heldTime_, held_);
+        }
+    }
+
+    uint64_t received() const { return received_; }
+    uint64_t kept() const { return kept_; }
+
+  private:
+    sdiBuiltInDTypeId type_;
+    size_t elements_;
+    size_t sampleBytes_;
+    bool linear_;
+    double tolerance_;
+    size_t decimation_;
+    size_t bucketCount_;
+    bool hasAnchor_;
+    bool hasHeld_;
+    uint64_t received_;
+    uint64_t kept_;
+
+    std::vector<double> values_;
+    std::vector<double> bucketTimes_;
+    std::vector<unsigned char> bucketSamples_;
+    std::vector<size_t> bucketMin_;
+    std::vector<size_t> bucketMax_;
+    std::vector<unsigned char> bucketKeep_;
+    std::vector<double> rangeMin_;
+    std::vector<double> rangeMax_;
+    std::vector<double> anchor_;
+    std::vector<double> slopeLo_;
+    std::vector<double> slopeHi_;
+    std::vector<double> held_;
+    std::vector<unsigned char> heldSample_;
+    double heldTime_;
+    double anchorTime_;
+
+    void load(const unsigned char *sample)
+    {
+        for (size_t e = 0; e < elements_; ++e) values_[e] = elementAsDouble(type_, sample, e);
+    }
+
+    template <typename Sink>
+    void bucket(double time, const unsigned char *sample, Sink &sink)
+    {
+        size_t i = bucketCount_++;
+        bucketTimes_[i] = time;
+        memcpy(&bucketSamples_[i * sampleBytes_], sample, sampleBytes_);
+        for (size_t e = 0; e < elements_; ++e) {
+            double v = elementAsDouble(type_, sample, e);
+            if (i == 0 || v < elementAsDouble(type_, &bucketSamples_[bucketMin_[e] * sampleBytes_], e)) {
+                bucketMin_[e] = i;
+            }
+            if (i == 0 || v > elementAsDouble(type_, &bucketSamples_[bucketMax_[e] * sampleBytes_], e)) {
+                bucketMax_[e] = i;
+            }
+        }
+        if (bucketCount_ == decimation_) emitBucket(sink);
+    }
+
+    template <typename Sink>
+    void emitBucket(Sink &sink)
+    {
+        if (bucketCount_ == 0) return;
+        memset(&bucketKeep_[0], 0, bucketCount_);
+        bucketKeep_[0] = bucketKeep_[bucketCount_ - 1] = 1;
+        for (size_t e = 0; e < elements_; ++e) {
+            bucketKeep_[bucketMin_[e]] = bucketKeep_[bucketMax_[e]] = 1;
+        }
+        size_t n = bucketCount_;
+        bucketCount_ = 0;
+        // The dead-band only tests the kept samples; see the note at the top of the file
+        for (size_t i = 0; i < n; ++i) {
+            if (bucketKeep_[i]) deadband(bucketTimes_[i], &bucketSamples_[i * sampleBytes_], sink);
+        }
+    }
+
+    template <typename Sink>
+    void deadband(double time, const unsigned char *sample, Sink &sink)
+    {
+        if (tolerance_ < 0) {
+            emit(time, sample, sink);
+            return;
+        }
+        load(sample);
+        for (size_t e = 0; e < elements_; ++e) {
+            if (values_[e] - values_[e] != 0) continue;
+            if (values_[e] < rangeMin_[e]) rangeMin_[e] = values_[e];
+            if (values_[e] > rangeMax_[e]) rangeMax_[e] = values_[e];
+        }
+        if (!hasAnchor_ || time <= (hasHeld_ ? heldTime_ : anchorTime_) || !finite()) {
+            if (hasHeld_) emit(heldTime_, &heldSample_[0], sink);
+            emit(time, sample, sink);
+            reanchor(time, values_);
+            return;
+        }
+        if (linear_ ? !narrow(anchorTime_, anchor_, time) : moved()) {
+            if (linear_ && hasHeld_) {
+                // The held sample is the last one the line from the anchor still fits
+                emit(heldTime_, &heldSample_[0], sink);
+                reanchor(heldTime_, held_);
+                narrow(anchorTime_, anchor_, time);
+            } else {
+                emit(time, sample, sink);
+                reanchor(time, values_);
+                return;
+            }
+        }
+        hold(time, sample);
+    }
+
+    /* Narrows the slopes from the anchor to those within the tolerance of values_ at time. False unless the line
+     * from the anchor to values_ itself is still within them, as it then passes every sample since the anchor. */
+    bool narrow(double anchorTime, const std::vector<double> &anchor, double time)
+    {
+        double dt = time - anchorTime;
+        bool fits = true;
+        for (size_t e = 0; e < elements_; ++e) {
+            double tol = tolerance_ * (rangeMax_[e] - rangeMin_[e]);
+            double lo = (values_[e] - tol - anchor[e]) / dt;
+            double hi = (values_[e] + tol - anchor[e]) / dt;
+            if (lo > slopeLo_[e]) slopeLo_[e] = lo;
+            if (hi < slopeHi_[e]) slopeHi_[e] = hi;
+            double slope = (values_[e] - anchor[e]) / dt;
+            if (slope < slopeLo_[e] || slope > slopeHi_[e]) fits = false;
+        }
+        return fits;
+    }
+
+    bool moved() const
+    {
+        for (size_t e = 0; e < elements_; ++e) {
+            double tol = tolerance_ * (rangeMax_[e] - rangeMin_[e]);
+            if (values_[e] - anchor_[e] > tol || anchor_[e] - values_[e] > tol) return true;
+        }
+        return false;
+    }
+
+    /* Infinite and NaN samples, and the first sample after them, are kept as they are */
+    bool finite() const
+    {
+        for (size_t e = 0; e < elements_; ++e) {
+            if (values_[e] - values_[e] != 0 || anchor_[e] - anchor_[e] != 0) return false;
+        }
+        return true;
+    }
+
+    void reanchor(double time, const std::vector<double> &values)
+    {
+        if (&values != &anchor_) anchor_ = values;
+        anchorTime_ = time;
+        hasAnchor_ = true;
+        hasHeld_ = false;
+        for (size_t e = 0; e < elements_; ++e) {
+            slopeLo_[e] = -std::numeric_limits<double>::infinity();
+            slopeHi_[e] = std::numeric_limits<double>::infinity();
+        }
+    }
+
+    void hold(double time, const unsigned char *sample)
+    {
+        held_ = values_;
+        heldTime_ = time;
+        memcpy(&heldSample_[0], sample, sampleBytes_);
+        hasHeld_ = true;
+    }
+
+    template <typename Sink>
+    void emit(double time, const unsigned char *sample, Sink &sink)
+    {
+        ++kept_;
+        sink(time, sample);
+    }
+
+    SignalThinner(const SignalThinner &);
+    SignalThinner &operator=(const SignalThinner &);
+};
+
+} /* namespace sdilocal */
+
+#endif
@@ -0,0 +1,43 @@
+// FevalBatcherTest.cpp : checks that a lone FevalBatcher call is sent after maxDelay
+//
+// Standalone console program, not part of Test.vcxproj. Build it against Test/include and link
+// libMatlabDataArray.lib; it returns non-zero on failure.
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "MatlabEngine.hpp"
+
+using namespace matlab::engine;
+
+int main()
+{
+    MockMATLABEngine engine;
+    // The batch function returns its 1xK cell of arguments, so each call gets its own argument back
+    engine.registerFunction(u"batchEcho", [](size_t, const std::vector<matlab::data::Array>& args) {
+        return std::vector<matlab::data::Array>(1, args[0]);
+    });
+
+    const std::chrono::milliseconds maxDelay(50);
+    BasicFevalBatcher<MockMATLABEngine> batcher(engine, u"batchEcho", 1, 256, maxDelay);
+    matlab::data::ArrayFactory factory;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    FutureResult<matlab::data::Array> result = batcher.fevalAsync({ factory.createScalar<double>(42) });
+
+    // No flush(): the call must go out once it has waited maxDelay, well before the batch fills
+    if (result.wait_for(maxDelay * 10) != std::future_status::ready) {
+        std::printf("FAILED: a single call was not sent within %d ms\n", (int)(maxDelay * 10).count());
+        return 1;
+    }
+    std::chrono::milliseconds elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    matlab::data::TypedArray<double> value = result.get();
+    if (value[0] != 42) {
+        std::printf("FAILED: wrong result %g\n", (double)value[0]);
+        return 1;
+    }
+    std::printf("passed: resolved after %d ms, maxDelay %d ms\n", (int)elapsed.count(), (int)maxDelay.count());
+    return 0;
+}